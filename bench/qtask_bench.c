@@ -0,0 +1,268 @@
+/*
+ * Scalability benchmark of the scheduler hot paths, prints CSV on stdout.
+ *
+ * Build one binary per configuration under test, e.g.
+ *   cc -O2 -I.. -DQTASK_HASH_SIZE=262144 -DQTASK_TICK_SCAN_MAX=0 -o bench_list qtask_bench.c ../qtask.c
+ *   cc -O2 -I.. -DQTASK_HASH_SIZE=262144 -DQTASK_USING_WHEEL=1 -o bench_wheel qtask_bench.c ../qtask.c
+ * Usage: qtask_bench [-m max_tasks] [-c]
+ *   -m  largest task count, the sweep goes 1, 10, 100, ... up to it (default 100000)
+ *   -c  keep the default handler clock, by default it is removed to time only the scheduler
+ *
+ * Columns: backend,op,tasks,dist,ready_ratio,iterations,ns_per_op
+ *   tick    qtask_tick_increase, per call
+ *   exec    qtask_exec, per call, ready_ratio of the tasks fire on every tick
+ * Both are timed one call at a time, less the calibrated cost of an empty timed region. The long
+ * distribution starts timing at its first releases and runs long enough to cross a level 2 cascade.
+ *   obj     qtask_obj on a random registered name
+ *   suspend qtask_suspend followed by qtask_resume of the same task, per pair
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "qtask.h"
+
+#define NAME_LEN        24
+#define PERIOD_IDLE     1000000000u
+#define OPS_TARGET      2000000u
+
+#if QTASK_USING_WHEEL
+#define BACKEND         "wheel"
+#else
+#define BACKEND         "list"
+#endif
+
+typedef struct {
+    const char *name;
+    size_t (*period)(size_t i);
+    size_t skip;            /* Untimed ticks before the first releases. */
+    size_t span;            /* Fewest timed ticks. */
+} PeriodDist;
+
+static QTaskSched sched;
+static QTaskObj *tasks;
+static char *names;
+static size_t task_num;
+static int keep_clock;
+static uint64_t sink;
+static double overhead;
+static uint32_t rng = 2463534242u;
+
+static uint32_t _rand(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static uint64_t _now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void _handle(void *ctx)
+{
+    sink += (uintptr_t)ctx;
+}
+
+static size_t _period_uniform(size_t i)
+{
+    (void)i;
+    return 1 + _rand() % 1000;
+}
+
+static size_t _period_harmonic(size_t i)
+{
+    static const size_t periods[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 };
+    (void)i;
+    return periods[_rand() % (sizeof(periods) / sizeof(periods[0]))];
+}
+
+static size_t _period_long(size_t i)
+{
+    (void)i;
+    return 1000 + _rand() % 100000;
+}
+
+static const PeriodDist dists[] = {
+    { "uniform", _period_uniform, 0, 0 },
+    { "harmonic", _period_harmonic, 0, 0 },
+    { "long", _period_long, 1000, (size_t)1 << (2 * QTASK_WHEEL_BITS) },
+};
+
+static const char *_name(size_t i)
+{
+    return &names[i * NAME_LEN];
+}
+
+static int _setup(size_t n, const PeriodDist *dist, double ready_ratio)
+{
+    size_t ready = (size_t)(n * ready_ratio + 0.5);
+
+    qtask_sched_init(&sched);
+#if QTASK_USING_IDLE
+    // Virtual ticks, a sleeping exec would only measure the sleep
+    qtask_idle_set(&sched, QNULL);
+#endif
+    if(!keep_clock) {
+        qtask_clock_set(&sched, QNULL);
+    }
+    for(size_t i = 0; i < n; i++) {
+        size_t period = dist ? dist->period(i) : ((i < ready) ? 1 : PERIOD_IDLE);
+        if(qtask_add_ctx(&sched, &tasks[i], _name(i), _handle, &tasks[i], period) != 0) {
+            fprintf(stderr, "qtask_add failed at %zu tasks\n", i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static size_t _iterations(size_t n)
+{
+    size_t it = OPS_TARGET / (n ? n : 1);
+    return (it < 200) ? 200 : it;
+}
+
+// Cost of an empty timed region, the best of a few rounds
+static double _overhead(void)
+{
+    double best = 0;
+    uint64_t start, cost;
+
+    for(int r = 0; r < 5; r++) {
+        cost = 0;
+        for(int i = 0; i < 100000; i++) {
+            start = _now();
+            cost += _now() - start;
+        }
+        if(r == 0 || (double)cost / 100000 < best) {
+            best = (double)cost / 100000;
+        }
+    }
+    return best;
+}
+
+static double _per_call(uint64_t cost, size_t it)
+{
+    double ns = (double)cost / it - overhead;
+    return (ns > 0) ? ns : 0;
+}
+
+static void _bench_tick(size_t n)
+{
+    for(size_t d = 0; d < sizeof(dists) / sizeof(dists[0]); d++) {
+        size_t it = _iterations(n);
+        uint64_t start, cost = 0;
+
+        if(it < dists[d].span) {
+            it = dists[d].span;
+        }
+        if(_setup(n, &dists[d], 0) < 0) {
+            return;
+        }
+        qtask_tick_advance(&sched, dists[d].skip);
+        qtask_exec(&sched);
+        for(size_t i = 0; i < it; i++) {
+            start = _now();
+            qtask_tick_increase(&sched);
+            cost += _now() - start;
+            qtask_exec(&sched);
+        }
+        printf("%s,tick,%zu,%s,,%zu,%.1f\n", BACKEND, n, dists[d].name, it, _per_call(cost, it));
+    }
+}
+
+static void _bench_exec(size_t n)
+{
+    static const double ratios[] = { 0, 0.001, 0.01, 0.1, 1 };
+
+    for(size_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); r++) {
+        size_t it = _iterations(n);
+        uint64_t start, cost = 0;
+
+        if(ratios[r] > 0 && n * ratios[r] < 0.5) {
+            continue;
+        }
+        if(_setup(n, QNULL, ratios[r]) < 0) {
+            return;
+        }
+        for(size_t i = 0; i < it; i++) {
+            qtask_tick_increase(&sched);
+            start = _now();
+            qtask_exec(&sched);
+            cost += _now() - start;
+        }
+        printf("%s,exec,%zu,,%g,%zu,%.1f\n", BACKEND, n, ratios[r], it, _per_call(cost, it));
+    }
+}
+
+static void _bench_lookup(size_t n)
+{
+    size_t it = 200000, idx;
+    uint64_t start, cost;
+
+    if(_setup(n, &dists[0], 0) < 0) {
+        return;
+    }
+
+    start = _now();
+    for(size_t i = 0; i < it; i++) {
+        sink += (uintptr_t)qtask_obj(&sched, _name(_rand() % n));
+    }
+    cost = _now() - start;
+    printf("%s,obj,%zu,uniform,,%zu,%.1f\n", BACKEND, n, it, (double)cost / it);
+
+    start = _now();
+    for(size_t i = 0; i < it; i++) {
+        idx = _rand() % n;
+        qtask_suspend(&sched, _name(idx));
+        qtask_resume(&sched, _name(idx));
+    }
+    cost = _now() - start;
+    printf("%s,suspend,%zu,uniform,,%zu,%.1f\n", BACKEND, n, it, (double)cost / it);
+}
+
+int main(int argc, char **argv)
+{
+    size_t max = 100000;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            max = strtoul(argv[++i], QNULL, 0);
+        } else if(strcmp(argv[i], "-c") == 0) {
+            keep_clock = 1;
+        } else {
+            fprintf(stderr, "usage: %s [-m max_tasks] [-c]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    task_num = max;
+    tasks = calloc(task_num, sizeof(QTaskObj));
+    names = malloc(task_num * NAME_LEN);
+    if(!tasks || !names) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for(size_t i = 0; i < task_num; i++) {
+        snprintf(&names[i * NAME_LEN], NAME_LEN, "t%zu", i);
+    }
+
+    overhead = _overhead();
+    printf("backend,op,tasks,dist,ready_ratio,iterations,ns_per_op\n");
+    for(size_t n = 1; n <= max; n *= 10) {
+        _bench_tick(n);
+        _bench_exec(n);
+        _bench_lookup(n);
+        fflush(stdout);
+    }
+
+    free(tasks);
+    free(names);
+    return (int)(sink & 0);
+}
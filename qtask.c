@@ -5,9 +5,18 @@
  * @ Modified time: 2025-07-08 00:31
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <stddef.h>
+#include <string.h>
 #include "qtask.h"
 
+#if defined(__linux__)
+#include <time.h>
+#endif
+
  // Macro for iterating through a doubly linked list
 #define QTASK_ITERATOR(node, list)  \
     for (node = (list)->next; node != (list); node = node->next)
@@ -36,42 +45,134 @@ static inline void _list_remove(QTaskList *node)
     node->next = node->prev = node;
 }
 
-static int _qtask_isexist(QTaskSched *sched, QTaskObj *task)
+// The id only rejects mismatches quickly, identity is always confirmed on the name
+static inline int _name_equal(const char *a, const char *b)
+{
+    if(a == b) {
+        return 1;
+    }
+    if(!a || !b) {
+        return 0;
+    }
+    return strcmp(a, b) == 0;
+}
+
+static QTaskObj *_list_find(QTaskSched *sched, uint32_t id, const char *name)
 {
     QTaskList *node;
-    QTaskObj *_task;
+    QTaskObj *task;
 
     QTASK_ITERATOR(node, &sched->task_list)
     {
-        _task = QTASK_ENTRY(node, QTaskObj, task_node);
-        if(task->id == _task->id) {
-            return 1;
+        task = QTASK_ENTRY(node, QTaskObj, task_node);
+        if(task->id == id && _name_equal(task->name, name)) {
+            return task;
         }
     }
-    return 0;
+    QTASK_ITERATOR(node, &sched->suspend_list)
+    {
+        task = QTASK_ENTRY(node, QTaskObj, task_node);
+        if(task->id == id && _name_equal(task->name, name)) {
+            return task;
+        }
+    }
+    return QNULL;
 }
 
-static int _qdtask_isexsit(QTaskSched *sched, QTaskObj *task)
+#if QTASK_HASH_SIZE > 0
+#define QTASK_HASH_MASK     (QTASK_HASH_SIZE - 1)
+
+// Open addressing with linear probing, tasks sharing an id sit in the same probe sequence
+static QTaskObj *_hash_find(QTaskSched *sched, uint32_t id, const char *name)
 {
-    QTaskList *node;
-    QTaskObj *_task;
+    size_t i = id & QTASK_HASH_MASK;
+    QTaskObj *task;
 
-    QTASK_ITERATOR(node, &sched->suspend_list)
-    {
-        _task = QTASK_ENTRY(node, QTaskObj, task_node);
-        if(task->id == _task->id) {
-            return 1;
+    for(size_t n = 0; n < QTASK_HASH_SIZE; n++) {
+        task = sched->hash[i];
+        if(task == QNULL) {
+            break;
+        }
+        if(task->id == id && _name_equal(task->name, name)) {
+            return task;
         }
+        i = (i + 1) & QTASK_HASH_MASK;
     }
-    return 0;
+    // Tasks added while the index was full are only on the lists
+    return sched->spilled ? _list_find(sched, id, name) : QNULL;
+}
+
+static void _hash_insert(QTaskSched *sched, QTaskObj *task)
+{
+    size_t i = task->id & QTASK_HASH_MASK;
+
+    for(size_t n = 0; n < QTASK_HASH_SIZE; n++) {
+        if(sched->hash[i] == QNULL) {
+            sched->hash[i] = task;
+            return;
+        }
+        if(sched->hash[i]->id == task->id) {
+            sched->collisions++;
+        }
+        i = (i + 1) & QTASK_HASH_MASK;
+    }
+    sched->spilled++;
+}
+
+static void _hash_remove(QTaskSched *sched, QTaskObj *task)
+{
+    size_t i = task->id & QTASK_HASH_MASK;
+    size_t j, home, n;
+
+    for(n = 0; n < QTASK_HASH_SIZE && sched->hash[i] != task; n++) {
+        if(sched->hash[i] == QNULL) {
+            break;
+        }
+        i = (i + 1) & QTASK_HASH_MASK;
+    }
+    if(sched->hash[i] != task) {
+        if(sched->spilled > 0) {
+            sched->spilled--;
+        }
+        return;
+    }
+    sched->hash[i] = QNULL;
+
+    // Backward shift deletion, pull up entries whose probe sequence crossed the hole
+    for(j = (i + 1) & QTASK_HASH_MASK; sched->hash[j] != QNULL; j = (j + 1) & QTASK_HASH_MASK) {
+        home = sched->hash[j]->id & QTASK_HASH_MASK;
+        if(((j - home) & QTASK_HASH_MASK) >= ((j - i) & QTASK_HASH_MASK)) {
+            sched->hash[i] = sched->hash[j];
+            sched->hash[j] = QNULL;
+            i = j;
+        }
+    }
+}
+#else
+static inline QTaskObj *_hash_find(QTaskSched *sched, uint32_t id, const char *name)
+{
+    return _list_find(sched, id, name);
+}
+
+static inline void _hash_insert(QTaskSched *sched, QTaskObj *task)
+{
+    (void)sched;
+    (void)task;
+}
+
+static inline void _hash_remove(QTaskSched *sched, QTaskObj *task)
+{
+    (void)sched;
+    (void)task;
 }
+#endif
 
-static uint16_t _id_calc(const char *name)
+static uint32_t _id_calc(const char *name)
 {
     if(!name) {
         return 0;
     }
-    uint16_t hash = 5381;
+    uint32_t hash = 5381;
     int c;
     while((c = *name++)) {
         hash = (hash << 5) + hash + c; // hash * 33 + c
@@ -79,190 +180,1929 @@ static uint16_t _id_calc(const char *name)
     return hash;
 }
 
-void qtask_sched_init(QTaskSched *sched)
+#if QTASK_USING_WHEEL
+// Releases of one tick follow the task list like the list backend walks it: periodic tasks
+// newest insertion first, then one-shot calls newest first
+static inline int _wheel_before(const QTaskObj *a, const QTaskObj *b)
 {
-    sched->task_list.prev = sched->task_list.next = &sched->task_list;
-    sched->suspend_list.prev = sched->suspend_list.next = &sched->suspend_list;
+    int a_oneshot = (a->state == QTASK_STATE_ONESHOT);
+    int b_oneshot = (b->state == QTASK_STATE_ONESHOT);
+
+    if(a_oneshot != b_oneshot) {
+        return b_oneshot;
+    }
+    return (int32_t)(a->seq - b->seq) > 0;
 }
 
-int qtask_add(QTaskSched *sched, QTaskObj *task, const char *name, QTaskHandle handle, size_t tick)
+static inline int _wheel_node_before(QTaskList *a, QTaskList *b)
 {
-    task->name = name;
-    task->id = _id_calc(name);
-    task->isready = 0;
-    task->handle = handle;
-    task->timer = tick;
-    task->period = tick;
-    task->rtime = 0;
-    task->rtick = 0;
+    return _wheel_before(QTASK_ENTRY(a, QTaskObj, timer_node), QTASK_ENTRY(b, QTaskObj, timer_node));
+}
 
-    if(_qdtask_isexsit(sched, task)) {
-        task->isready = 0;
-        task->timer = task->period;
-        _list_remove(&task->task_node);
+// Cut the ordered run starting at node off a QNULL terminated chain, returns the next run
+static QTaskList *_wheel_run_cut(QTaskList *node)
+{
+    QTaskList *next;
+
+    while((next = node->next) != QNULL && !_wheel_node_before(next, node)) {
+        node = next;
     }
+    node->next = QNULL;
+    return next;
+}
 
-    if(!_qtask_isexist(sched, task)) {
-        _list_insert(&sched->task_list, &task->task_node);
-        return 0;
+// Merge two ordered runs, a is the earlier one and keeps its place among equals
+static QTaskList *_wheel_merge(QTaskList *a, QTaskList *b)
+{
+    QTaskList head, *last = &head;
+
+    while(a && b) {
+        if(_wheel_node_before(b, a)) {
+            last->next = b;
+            b = b->next;
+        } else {
+            last->next = a;
+            a = a->next;
+        }
+        last = last->next;
     }
-    return 1;
+    last->next = a ? a : b;
+    return head.next;
 }
 
-int qtask_del(QTaskSched *sched, QTaskObj *task)
+// Put expired tasks in release order. Re-armed tasks arrive in the order of their previous expiry,
+// so a mixed slot is a few ordered runs. Each run is cut once and merged like a binary counter,
+// pending[i] holds 2^i runs.
+static void _wheel_sort(QTaskList *list)
 {
-    if(_qtask_isexist(sched, task)) {
-        task->isready = 0;
-        task->timer = task->period;
-        _list_remove(&task->task_node);
+    QTaskList *pending[32] = { QNULL };
+    QTaskList *run, *rest, *node, *prev;
+    int i;
+
+    if(list->next == list || list->next == list->prev) {
+        return;
+    }
+    list->prev->next = QNULL;
+    rest = list->next;
+    run = rest;
+    rest = _wheel_run_cut(run);
+    for(;;) {
+        for(i = 0; pending[i]; i++) {
+            run = _wheel_merge(pending[i], run);
+            pending[i] = QNULL;
+        }
+        pending[i] = run;
+        if(rest == QNULL) {
+            break;
+        }
+        run = rest;
+        rest = _wheel_run_cut(run);
+    }
+    run = QNULL;
+    for(i = 0; i < 32; i++) {
+        if(pending[i]) {
+            run = run ? _wheel_merge(pending[i], run) : pending[i];
+        }
     }
 
-    if(!_qdtask_isexsit(sched, task)) {
-        _list_insert(&sched->suspend_list, &task->task_node);
-        return 0;
+    prev = list;
+    for(node = run; node; node = node->next) {
+        node->prev = prev;
+        prev->next = node;
+        prev = node;
     }
-    return -1;
+    prev->next = list;
+    list->prev = prev;
 }
 
-int qtask_suspend(QTaskSched *sched, const char *name)
+// Level 0 slots are filled at the tail and flagged once a task does not go after the tail, only
+// flagged slots are sorted when they expire
+static inline void _wheel_slot_add(QTaskSched *sched, size_t idx, QTaskObj *task)
 {
-    QTaskList *node, *safe;
-    QTaskObj *task;
-    uint16_t id = _id_calc(name);
+    QTaskList *slot = &sched->wheel[0][idx];
 
-    QTASK_ITERATOR_SAFE(node, safe, &sched->task_list)
-    {
-        task = QTASK_ENTRY(node, QTaskObj, task_node);
-        if(task->id == id) {
-            if(_qtask_isexist(sched, task)) {
-                task->isready = 0;
-                task->timer = task->period;
-                _list_remove(&task->task_node);
-            }
+    if(slot->next == slot) {
+        sched->wheel_mixed[idx] = 0;
+    } else if(_wheel_before(task, QTASK_ENTRY(slot->prev, QTaskObj, timer_node))) {
+        sched->wheel_mixed[idx] = 1;
+    }
+    _list_insert(slot->prev, &task->timer_node);
+}
 
-            if(!_qdtask_isexsit(sched, task)) {
-                _list_insert(&sched->suspend_list, &task->task_node);
-                return 0;
-            }
-            return -1;
-        }
+static void _wheel_insert(QTaskSched *sched, QTaskObj *task)
+{
+    uint64_t delta, at;
+    int level = 0;
+
+    // Only a cascade can see an expire on the tick being processed, the current slot runs right after it
+    if(task->expire <= sched->tick) {
+        _wheel_slot_add(sched, sched->tick & QTASK_WHEEL_MASK, task);
+        return;
     }
-    return -1;
 
+    delta = task->expire - sched->tick;
+    at = task->expire;
+    while(level < QTASK_WHEEL_LEVELS - 1 && delta >= ((uint64_t)1 << (QTASK_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    if(delta >= ((uint64_t)1 << (QTASK_WHEEL_BITS * QTASK_WHEEL_LEVELS))) {
+        // Out of range, park in the farthest slot and re-cascade from there
+        at = sched->tick + ((uint64_t)1 << (QTASK_WHEEL_BITS * QTASK_WHEEL_LEVELS)) - 1;
+    }
+    if(level == 0) {
+        _wheel_slot_add(sched, at & QTASK_WHEEL_MASK, task);
+        return;
+    }
+    _list_insert(sched->wheel[level][(at >> (QTASK_WHEEL_BITS * level)) & QTASK_WHEEL_MASK].prev, &task->timer_node);
 }
 
-int qtask_resume(QTaskSched *sched, const char *name)
+static void _wheel_cascade(QTaskSched *sched, int level)
 {
+    QTaskList *slot = &sched->wheel[level][(sched->tick >> (QTASK_WHEEL_BITS * level)) & QTASK_WHEEL_MASK];
     QTaskList *node, *safe;
     QTaskObj *task;
-    uint16_t id = _id_calc(name);
 
-    QTASK_ITERATOR_SAFE(node, safe, &sched->suspend_list)
+    QTASK_ITERATOR_SAFE(node, safe, slot)
     {
-        task = QTASK_ENTRY(node, QTaskObj, task_node);
-        if(task->id == id) {
-            if(_qdtask_isexsit(sched, task)) {
-                task->isready = 0;
-                task->timer = task->period;
-                _list_remove(&task->task_node);
-            }
+        task = QTASK_ENTRY(node, QTaskObj, timer_node);
+        _list_remove(&task->timer_node);
+        _wheel_insert(sched, task);
+    }
+}
+#endif
 
-            if(!_qtask_isexist(sched, task)) {
-                _list_insert(&sched->task_list, &task->task_node);
-                return 0;
-            }
-        }
+// Same as _timer_start for a caller already in the critical section
+static inline void _timer_arm(QTaskSched *sched, QTaskObj *task, size_t tick)
+{
+#if QTASK_USING_ABSOLUTE
+    task->release_tick = sched->tick + tick;
+#endif
+#if QTASK_USING_WHEEL
+    _list_remove(&task->timer_node);
+    task->timer = tick;
+    if(tick > 0) {
+        task->expire = sched->tick + tick;
+        _wheel_insert(sched, task);
     }
-    return -1;
+#else
+    (void)sched;
+    task->timer = tick;
+#endif
 }
 
-QTaskObj *qtask_obj(QTaskSched *sched, const char *taskname)
+// Arm the task timer to expire after tick ticks, 0 leaves the task idle
+static void _timer_start(QTaskSched *sched, QTaskObj *task, size_t tick)
 {
-    QTaskList *node;
-    QTaskObj *task;
-    uint16_t id = _id_calc(taskname);
+    QTASK_CRITICAL_ENTER();
+    _timer_arm(sched, task, tick);
+    QTASK_CRITICAL_EXIT();
+}
 
-    QTASK_ITERATOR(node, &sched->task_list)
-    {
-        task = QTASK_ENTRY(node, QTaskObj, task_node);
-        if(task->id == id) {
-            return task;
-        }
+#if QTASK_USING_ABSOLUTE
+// Account an expired timer on the release grid, returns the releases it covers and re-arms past the current tick
+static size_t _release_expire(QTaskSched *sched, QTaskObj *task)
+{
+    uint64_t late = (sched->tick > task->release_tick) ? sched->tick - task->release_tick : 0;
+    size_t n;
+
+    if(task->period == 0) {
+        task->timer = 0;
+        return 1;
     }
-    return QNULL;
+    n = (size_t)(1 + late / task->period);
+    task->release_tick += (uint64_t)n * task->period;
+    task->timer = (size_t)(task->release_tick - sched->tick);
+    return n;
 }
 
-void qtask_exec(QTaskSched *sched)
+// Ticks from now to the first release of the task grid at least tick ticks away
+static size_t _release_align(QTaskSched *sched, QTaskObj *task, size_t tick)
 {
-    QTaskList *node, *safe;
-    QTaskObj *task;
+    uint64_t at = sched->tick + tick;
 
-    QTASK_ITERATOR_SAFE(node, safe, &sched->task_list)
-    {
-        task = QTASK_ENTRY(node, QTaskObj, task_node);
-        if(task->isready) {
-            task->handle();
-            task->rtime = task->rtick;
-            task->isready = 0;
-            task->rtick = 0;
-        }
+    if(task->period == 0) {
+        return tick;
+    }
+    if(at <= task->release_tick) {
+        at = task->release_tick - (task->release_tick - at) / task->period * task->period;
+    } else {
+        at = task->release_tick + (at - task->release_tick + task->period - 1) / task->period * task->period;
     }
+    return (size_t)(at - sched->tick);
 }
+#endif
 
-void qtask_tick_increase(QTaskSched *sched)
+// Disarm the task timer, the caller is in the critical section
+static inline void _timer_unlink(QTaskObj *task)
 {
-    QTaskList *node, *safe;
-    QTaskObj *task;
-    int count = 0;
+#if QTASK_USING_WHEEL
+    _list_remove(&task->timer_node);
+#else
+    (void)task;
+#endif
+}
 
-    QTASK_ITERATOR_SAFE(node, safe, &sched->task_list)
-    {
-        if(node == QNULL || node->next == QNULL || node->prev == QNULL) {
-            return;
+// Index of the highest set bit, map must not be 0
+static inline int _log2(uint32_t map)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 31 - __builtin_clz(map);
+#else
+    int prio = 0;
+    if(map & 0xffff0000u) { map >>= 16; prio += 16; }
+    if(map & 0xff00u) { map >>= 8; prio += 8; }
+    if(map & 0xf0u) { map >>= 4; prio += 4; }
+    if(map & 0xcu) { map >>= 2; prio += 2; }
+    if(map & 0x2u) { prio += 1; }
+    return prio;
+#endif
+}
+
+#if QTASK_USING_EDF
+static inline int _edf_before(const QTaskObj *a, const QTaskObj *b)
+{
+    if(a->abs_deadline != b->abs_deadline) {
+        return a->abs_deadline < b->abs_deadline;
+    }
+    return a->priority > b->priority;
+}
+
+static inline void _edf_place(QTaskSched *sched, size_t i, QTaskObj *task)
+{
+    sched->edf_heap[i] = task;
+    task->heap_idx = i + 1;
+}
+
+static void _edf_sift_up(QTaskSched *sched, size_t i)
+{
+    QTaskObj *task = sched->edf_heap[i];
+
+    while(i > 0 && _edf_before(task, sched->edf_heap[(i - 1) / 2])) {
+        _edf_place(sched, i, sched->edf_heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    _edf_place(sched, i, task);
+}
+
+static void _edf_sift_down(QTaskSched *sched, size_t i)
+{
+    QTaskObj *task = sched->edf_heap[i];
+    size_t child;
+
+    while((child = 2 * i + 1) < sched->edf_num) {
+        if(child + 1 < sched->edf_num && _edf_before(sched->edf_heap[child + 1], sched->edf_heap[child])) {
+            child++;
+        }
+        if(!_edf_before(sched->edf_heap[child], task)) {
+            break;
         }
+        _edf_place(sched, i, sched->edf_heap[child]);
+        i = child;
+    }
+    _edf_place(sched, i, task);
+}
 
-        task = QTASK_ENTRY(node, QTaskObj, task_node);
-        if(task == QNULL) {
+static void _edf_remove(QTaskSched *sched, QTaskObj *task)
+{
+    size_t i = task->heap_idx - 1;
+
+    task->heap_idx = 0;
+    if(--sched->edf_num == i) {
+        return;
+    }
+    task = sched->edf_heap[sched->edf_num];
+    sched->edf_heap[i] = task;
+    _edf_sift_down(sched, i);
+    _edf_sift_up(sched, task->heap_idx - 1);
+}
+#endif
+
+#if QTASK_USING_TRACE
+static inline void _trace(QTaskSched *sched, uint8_t type, uint32_t key)
+{
+    QTaskTraceEvt *evt;
+    uint32_t idx;
+
+    if(!sched->trace_on) {
+        return;
+    }
+#if defined(__GNUC__) || defined(__clang__)
+    idx = __atomic_fetch_add(&sched->trace_head, 1, __ATOMIC_RELAXED);
+#else
+    QTASK_CRITICAL_ENTER();
+    idx = sched->trace_head++;
+    QTASK_CRITICAL_EXIT();
+#endif
+    evt = &sched->trace[idx & (QTASK_TRACE_SIZE - 1)];
+    evt->time = sched->clock ? sched->clock() : (uint32_t)sched->tick;
+    evt->key = key;
+    evt->type = type;
+}
+
+#define QTASK_TRACE(sched, type, key)   _trace(sched, type, key)
+#else
+#define QTASK_TRACE(sched, type, key)
+#endif
+
+#if QTASK_USING_RECORD
+static size_t _rec_put(uint8_t *buf, uint64_t value, size_t len)
+{
+    for(size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(value >> (8 * i));
+    }
+    return len;
+}
+
+static size_t _rec_varint(uint8_t *buf, uint64_t value)
+{
+    size_t len = 0;
+
+    while(value >= 0x80) {
+        buf[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buf[len++] = (uint8_t)value;
+    return len;
+}
+
+// Encode and write one event, the caller keeps other records out until it is written whole
+static void _record(QTaskSched *sched, uint8_t type, QTaskObj *task, size_t arg)
+{
+    uint8_t buf[48];
+    size_t len = 0, name_len = 0;
+
+    if(!sched->record) {
+        return;
+    }
+    if(type == QTASK_REC_CONFIG || type == QTASK_REC_CONFIG_TICK) {
+        // Setters without a scheduler only flag the change, it is written before it is first used
+        if(!task->recfg) {
             return;
         }
-
-        if(task->timer > 0) {
-            if(--task->timer <= 0) {
-                task->isready = 1;
-                sched->run_task = task;
-                task->timer = task->period;
-            }
+        task->recfg = 0;
+    } else if(task && task->recfg) {
+        // The call may release the task right away, the replay needs the change before it
+        _record(sched, QTASK_REC_CONFIG, task, 0);
+    }
+    buf[len++] = type;
+    if(task) {
+        len += _rec_varint(&buf[len], (uintptr_t)task);
+    }
+    switch(type) {
+    case QTASK_REC_ADVANCE:
+    case QTASK_REC_SLEEP:
+    case QTASK_REC_DEFER:
+    case QTASK_REC_PHASE:
+        len += _rec_varint(&buf[len], arg);
+        break;
+    case QTASK_REC_PRIO:
+    case QTASK_REC_POLICY:
+        buf[len++] = (uint8_t)arg;
+        break;
+    case QTASK_REC_ADD:
+        name_len = task->name ? strlen(task->name) : 0;
+        name_len = (name_len > 255) ? 255 : name_len;
+        buf[len++] = (uint8_t)name_len;
+        break;
+    case QTASK_REC_CONFIG:
+    case QTASK_REC_CONFIG_TICK:
+        len += _rec_varint(&buf[len], task->period);
+#if QTASK_USING_EDF || QTASK_USING_DEADLINE
+        len += _rec_varint(&buf[len], task->deadline);
+#else
+        len += _rec_varint(&buf[len], 0);
+#endif
+#if QTASK_USING_OVERRUN
+        buf[len++] = task->overrun;
+        len += _rec_varint(&buf[len], task->catchup);
+#else
+        buf[len++] = QTASK_OVERRUN_ONCE;
+        len += _rec_varint(&buf[len], 1);
+#endif
+        break;
+    default:
+        break;
+    }
+    sched->record(buf, len, sched->record_arg);
+    if(type == QTASK_REC_ADD) {
+        if(name_len) {
+            sched->record(task->name, name_len, sched->record_arg);
         }
-        count++;
+        sched->record(buf, _rec_varint(buf, task->period), sched->record_arg);
+    }
+}
+
+// QTASK_RECORD is for the main loop, QTASK_RECORD_IRQ for the tick and code already in the critical section
+#define QTASK_RECORD(sched, type, task, arg) \
+    do { QTASK_CRITICAL_ENTER(); _record(sched, type, task, arg); QTASK_CRITICAL_EXIT(); } while(0)
+#define QTASK_RECORD_IRQ(sched, type, task, arg)    _record(sched, type, task, arg)
+#else
+#define QTASK_RECORD(sched, type, task, arg)
+#define QTASK_RECORD_IRQ(sched, type, task, arg)
+#endif
+
+// Count n activations of a task whose timer expired, a task already waiting keeps its place
+static inline void _ready_push(QTaskSched *sched, QTaskObj *task, size_t n)
+{
+#if QTASK_USING_OVERRUN
+    if(n > (size_t)(UINT16_MAX - task->pending)) {
+        task->missed += (uint32_t)(n - (UINT16_MAX - task->pending));
+        n = UINT16_MAX - task->pending;
+    }
+    QTASK_RECORD_IRQ(sched, QTASK_REC_CONFIG_TICK, task, 0);
+    task->pending += (uint16_t)n;
+#else
+    (void)n;
+    QTASK_RECORD_IRQ(sched, QTASK_REC_CONFIG_TICK, task, 0);
+#endif
+    QTASK_TRACE(sched, QTASK_TRACE_RELEASE, task->trace_key);
 
-        if(count > 1000) {
+    if(!task->isready) {
+        task->isready = 1;
+#if QTASK_USING_STATS
+        if(sched->clock) {
+            task->release = sched->clock();
+        }
+#endif
+#if QTASK_USING_DEADLINE
+        // A deadline set from here on only applies to the next release
+        task->dl_check = (task->deadline != 0);
+#endif
+#if QTASK_USING_EDF
+        task->abs_deadline = sched->tick + (task->deadline ? task->deadline : task->period);
+        if(sched->policy == QTASK_POLICY_EDF && sched->edf_num < QTASK_EDF_HEAP_SIZE) {
+            sched->edf_heap[sched->edf_num] = task;
+            _edf_sift_up(sched, sched->edf_num++);
             return;
         }
+#elif QTASK_USING_DEADLINE
+        // Only miss detection reads it without EDF
+        if(task->dl_check) {
+            task->abs_deadline = sched->tick + task->deadline;
+        }
+#endif
+        _list_insert(sched->ready_list[task->priority].prev, &task->ready_node);
+        sched->ready_map |= (uint32_t)1 << task->priority;
     }
 }
 
-void qtask_runtime_increase(QTaskSched *sched)
+static inline void _ready_unlink(QTaskSched *sched, QTaskObj *task)
 {
-    QTaskList *node;
-    QTaskObj *task;
+    _list_remove(&task->ready_node);
+    if(sched->ready_list[task->priority].next == &sched->ready_list[task->priority]) {
+        sched->ready_map &= ~((uint32_t)1 << task->priority);
+    }
+}
 
-    QTASK_ITERATOR(node, &sched->task_list)
-    {
-        task = QTASK_ENTRY(node, QTaskObj, task_node);
-        if(task->isready) {
-            task->rtick++;
-        }
+// Whether a ready task goes before the running one, for dispatch nested in its handler
+static inline int _ready_before(QTaskSched *sched, const QTaskObj *task, const QTaskObj *run)
+{
+#if QTASK_USING_EDF
+    if(sched->policy == QTASK_POLICY_EDF) {
+        return _edf_before(task, run);
     }
+#endif
+    (void)sched;
+    return task->priority > run->priority;
 }
 
-void qtask_sleep(QTaskSched *sched, size_t tick)
+// Dequeue the next task and take over its pending activations, later releases queue it again.
+// With above set only a task that goes before it is dequeued.
+static QTaskObj *_ready_pop(QTaskSched *sched, uint16_t *pending, const QTaskObj *above)
+{
+    QTaskObj *task = QNULL;
+
+    QTASK_CRITICAL_ENTER();
+#if QTASK_USING_EDF
+    if(sched->edf_num) {
+        task = sched->edf_heap[0];
+    } else
+#endif
+    if(sched->ready_map) {
+        task = QTASK_ENTRY(sched->ready_list[_log2(sched->ready_map)].next, QTaskObj, ready_node);
+    }
+    if(task && above && !_ready_before(sched, task, above)) {
+        task = QNULL;
+    }
+    if(task) {
+#if QTASK_USING_EDF
+        if(task->heap_idx) {
+            _edf_remove(sched, task);
+        } else
+#endif
+        _ready_unlink(sched, task);
+        task->isready = 0;
+#if QTASK_USING_OVERRUN
+        *pending = task->pending;
+        task->pending = 0;
+#else
+        *pending = 1;
+#endif
+        QTASK_RECORD_IRQ(sched, QTASK_REC_CONFIG, task, 0);
+        QTASK_RECORD_IRQ(sched, QTASK_REC_DISPATCH, task, 0);
+    }
+    QTASK_CRITICAL_EXIT();
+    return task;
+}
+
+// Drop a task from the ready queues with its pending activations, the caller is in the critical section
+static void _ready_detach(QTaskSched *sched, QTaskObj *task)
+{
+    task->isready = 0;
+#if QTASK_USING_OVERRUN
+    task->pending = 0;
+#endif
+#if QTASK_USING_EDF
+    if(task->heap_idx) {
+        _edf_remove(sched, task);
+    }
+#endif
+    if(task->ready_node.next != &task->ready_node) {
+        _ready_unlink(sched, task);
+    }
+}
+
+#if defined(__linux__)
+static uint32_t _clock_default(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+
+#if QTASK_USING_IDLE
+static void _idle_default(size_t ticks)
+{
+    struct timespec ts;
+    uint64_t ns;
+
+    if(ticks == 0) {
+        return;
+    }
+    // Nothing armed, a task can still be released from a signal or another thread
+    ns = (ticks == QTASK_TICK_NONE) ? (uint64_t)QTASK_TICK_NS : (uint64_t)ticks * QTASK_TICK_NS;
+    ts.tv_sec = (time_t)(ns / 1000000000u);
+    ts.tv_nsec = (long)(ns % 1000000000u);
+    clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, QNULL);
+}
+#endif
+#endif
+
+void qtask_sched_init(QTaskSched *sched)
 {
-    if(!sched->run_task) {
-        sched->run_task->timer = tick;
+    sched->task_list.prev = sched->task_list.next = &sched->task_list;
+    sched->suspend_list.prev = sched->suspend_list.next = &sched->suspend_list;
+    for(int i = 0; i < QTASK_PRIO_NUM; i++) {
+        sched->ready_list[i].prev = sched->ready_list[i].next = &sched->ready_list[i];
+    }
+    sched->ready_map = 0;
+    sched->policy = QTASK_POLICY_PRIO;
+#if QTASK_USING_EDF
+    sched->edf_num = 0;
+#endif
+    sched->run_task = QNULL;
+    sched->run_start = 0;
+#if defined(__linux__)
+    sched->clock = _clock_default;
+#else
+    sched->clock = QNULL;
+#endif
+#if QTASK_USING_IDLE && defined(__linux__)
+    sched->idle = _idle_default;
+#elif QTASK_USING_IDLE
+    sched->idle = QNULL;
+#endif
+    sched->tick = 0;
+    sched->defer_num = 0;
+#if QTASK_USING_LOAD
+    qtask_load_reset(sched);
+#endif
+#if QTASK_USING_TRACE
+    sched->trace_head = 0;
+    sched->trace_keys = 0;
+    sched->trace_on = 1;
+#endif
+#if QTASK_USING_RECORD
+    sched->record = QNULL;
+    sched->record_arg = QNULL;
+#endif
+#if QTASK_HASH_SIZE > 0
+    for(int i = 0; i < QTASK_HASH_SIZE; i++) {
+        sched->hash[i] = QNULL;
     }
+    sched->collisions = 0;
+    sched->spilled = 0;
+#endif
+#if QTASK_USING_WHEEL
+    for(int i = 0; i < QTASK_WHEEL_LEVELS; i++) {
+        for(int j = 0; j < (int)QTASK_WHEEL_SIZE; j++) {
+            sched->wheel[i][j].prev = sched->wheel[i][j].next = &sched->wheel[i][j];
+        }
+    }
+    memset(sched->wheel_mixed, 0, sizeof(sched->wheel_mixed));
+    sched->seq = 0;
+#endif
+#if QTASK_POOL_SIZE > 0
+    sched->pool_free = QNULL;
+    for(int i = QTASK_POOL_SIZE - 1; i >= 0; i--) {
+        sched->pool[i].obj.state = QTASK_STATE_NONE;
+        sched->pool[i].obj.owner = QNULL;
+        sched->pool[i].obj.name = QNULL;
+        sched->pool[i].obj.task_node.next = sched->pool_free;
+        sched->pool_free = &sched->pool[i].obj.task_node;
+    }
+#endif
+}
+
+// Take a scheduled task off the timer and ready queues and park it on the suspend list
+// Take a scheduled task off the timer and ready queues and park it on the suspend list.
+// All in one critical section, a tick in between would queue the task again.
+static void _task_park(QTaskSched *sched, QTaskObj *task)
+{
+    QTASK_CRITICAL_ENTER();
+    _ready_detach(sched, task);
+    _timer_unlink(task);
+    task->timer = task->period;
+    _list_remove(&task->task_node);
+    _list_insert(&sched->suspend_list, &task->task_node);
+    task->state = QTASK_STATE_SUSPEND;
+    QTASK_CRITICAL_EXIT();
+}
+
+// Disarm a one-shot call and take it off the task list, one-shot calls are not indexed
+static void _oneshot_unlink(QTaskSched *sched, QTaskObj *task)
+{
+    QTASK_CRITICAL_ENTER();
+    _ready_detach(sched, task);
+    _timer_unlink(task);
+    task->timer = 0;
+    _list_remove(&task->task_node);
+    sched->defer_num--;
+    task->state = QTASK_STATE_NONE;
+    task->owner = QNULL;
+    QTASK_CRITICAL_EXIT();
+}
+
+// Remove a registered task from every scheduler structure
+static void _task_unlink(QTaskSched *sched, QTaskObj *task)
+{
+    if(task->state == QTASK_STATE_ONESHOT) {
+        _oneshot_unlink(sched, task);
+        return;
+    }
+    QTASK_CRITICAL_ENTER();
+    if(task->state == QTASK_STATE_SCHED) {
+        _ready_detach(sched, task);
+        _timer_unlink(task);
+    }
+    _list_remove(&task->task_node);
+    task->state = QTASK_STATE_NONE;
+    task->owner = QNULL;
+    QTASK_CRITICAL_EXIT();
+    _hash_remove(sched, task);
+}
+
+// Objects may be handed in uninitialized, only the scheduler that linked a task trusts its state
+static inline uint8_t _task_state(QTaskSched *sched, const QTaskObj *task)
+{
+    return (task->owner == sched) ? task->state : QTASK_STATE_NONE;
+}
+
+static inline void _task_nodes_init(QTaskObj *task)
+{
+    task->ready_node.prev = task->ready_node.next = &task->ready_node;
+#if QTASK_USING_WHEEL
+    task->timer_node.prev = task->timer_node.next = &task->timer_node;
+#endif
+}
+
+static void _task_init(QTaskObj *task, const char *name, uint32_t id, QTaskHandle handle,
+                       QTaskHandleCtx handle_ctx, void *ctx, size_t tick)
+{
+    task->name = name;
+    task->id = id;
+    task->isready = 0;
+#if QTASK_USING_DEADLINE
+    task->dl_check = 0;
+#endif
+    task->priority = 0;
+    task->handle = handle;
+    task->handle_ctx = handle_ctx;
+    task->ctx = ctx;
+    task->timer = tick;
+    task->period = tick;
+    task->rtime = 0;
+    task->rtick = 0;
+#if QTASK_USING_EDF || QTASK_USING_DEADLINE
+    task->deadline = 0;
+    task->abs_deadline = 0;
+#endif
+#if QTASK_USING_EDF
+    task->heap_idx = 0;
+#endif
+#if QTASK_USING_OVERRUN
+    task->pending = 0;
+    task->missed = 0;
+    task->overrun = QTASK_OVERRUN_ONCE;
+    task->catchup = 1;
+#endif
+#if QTASK_USING_LOAD
+    task->cpu_time = 0;
+#endif
+#if QTASK_USING_DEADLINE
+    task->dmiss = 0;
+    task->miss_hook = QNULL;
+#endif
+#if QTASK_USING_BUDGET
+    task->budget = 0;
+#endif
+#if QTASK_USING_RECORD
+    task->recfg = 0;
+#endif
+#if QTASK_USING_ABSOLUTE
+    task->release_tick = 0;
+#endif
+#if QTASK_USING_STATS
+    qtask_stats_reset(task);
+#endif
+}
+
+static int _qtask_add(QTaskSched *sched, QTaskObj *task, const char *name, QTaskHandle handle,
+                      QTaskHandleCtx handle_ctx, void *ctx, size_t tick)
+{
+    uint32_t id = _id_calc(name);
+    QTaskObj *_task = _hash_find(sched, id, name);
+
+    if(_task && _task->state == QTASK_STATE_SCHED) {
+        return 1;
+    }
+    if(_task) {
+        _task_unlink(sched, _task);
+    }
+    if(_task_state(sched, task) == QTASK_STATE_ONESHOT) {
+        _task_unlink(sched, task);
+    }
+    if(_task_state(sched, task) != QTASK_STATE_NONE && _hash_find(sched, task->id, task->name) == task) {
+        // Same object registered under another name
+        QTASK_RECORD(sched, QTASK_REC_DEL, task, 0);
+        _task_unlink(sched, task);
+    }
+
+    _task_init(task, name, id, handle, handle_ctx, ctx, tick);
+#if QTASK_USING_TRACE
+    task->trace_key = ++sched->trace_keys;
+#endif
+    _hash_insert(sched, task);
+    task->state = QTASK_STATE_SCHED;
+    task->owner = sched;
+    _task_nodes_init(task);
+#if QTASK_USING_WHEEL
+    task->seq = ++sched->seq;
+#endif
+    QTASK_CRITICAL_ENTER();
+    _list_insert(&sched->task_list, &task->task_node);
+    QTASK_CRITICAL_EXIT();
+    _timer_start(sched, task, tick);
+    QTASK_TRACE(sched, QTASK_TRACE_ADD, task->trace_key);
+    QTASK_RECORD(sched, QTASK_REC_ADD, task, 0);
+    return 0;
+}
+
+int qtask_add(QTaskSched *sched, QTaskObj *task, const char *name, QTaskHandle handle, size_t tick)
+{
+    return _qtask_add(sched, task, name, handle, QNULL, QNULL, tick);
+}
+
+int qtask_add_ctx(QTaskSched *sched, QTaskObj *task, const char *name, QTaskHandleCtx handle, void *ctx, size_t tick)
+{
+    return _qtask_add(sched, task, name, QNULL, handle, ctx, tick);
+}
+
+#if QTASK_POOL_SIZE > 0
+static QTaskObj *_qtask_create(QTaskSched *sched, const char *name, QTaskHandle handle,
+                               QTaskHandleCtx handle_ctx, void *ctx, size_t tick)
+{
+    QTaskSlot *slot;
+    size_t len;
+
+    if(!name || sched->pool_free == QNULL) {
+        return QNULL;
+    }
+    len = strlen(name);
+    if(len >= QTASK_POOL_NAME_LEN || _hash_find(sched, _id_calc(name), name) != QNULL) {
+        return QNULL;
+    }
+
+    slot = QTASK_ENTRY(sched->pool_free, QTaskSlot, obj.task_node);
+    sched->pool_free = slot->obj.task_node.next;
+    memcpy(slot->name, name, len + 1);
+    if(_qtask_add(sched, &slot->obj, slot->name, handle, handle_ctx, ctx, tick) != 0) {
+        slot->obj.task_node.next = sched->pool_free;
+        sched->pool_free = &slot->obj.task_node;
+        return QNULL;
+    }
+    return &slot->obj;
+}
+
+QTaskObj *qtask_create(QTaskSched *sched, const char *name, QTaskHandle handle, size_t tick)
+{
+    return _qtask_create(sched, name, handle, QNULL, QNULL, tick);
+}
+
+QTaskObj *qtask_create_ctx(QTaskSched *sched, const char *name, QTaskHandleCtx handle, void *ctx, size_t tick)
+{
+    return _qtask_create(sched, name, QNULL, handle, ctx, tick);
+}
+
+int qtask_destroy(QTaskSched *sched, QTaskObj *task)
+{
+    uintptr_t offset = (uintptr_t)task - (uintptr_t)sched->pool;
+
+    // Free slots have no name, a used slot may already be unlinked by a qtask_add of its name
+    if(offset >= sizeof(sched->pool) || offset % sizeof(QTaskSlot) != 0 || task->name == QNULL) {
+        return -1;
+    }
+    if(task->state != QTASK_STATE_NONE) {
+        QTASK_TRACE(sched, QTASK_TRACE_DEL, task->trace_key);
+        QTASK_RECORD(sched, QTASK_REC_DEL, task, 0);
+        _task_unlink(sched, task);
+    }
+    // Destroyed by its own handler, _dispatch must not touch the slot once the handler returns
+    if(sched->run_task == task) {
+        sched->run_task = QNULL;
+    }
+    task->name = QNULL;
+    task->task_node.next = sched->pool_free;
+    sched->pool_free = &task->task_node;
+    return 0;
+}
+#endif
+
+int qtask_del(QTaskSched *sched, QTaskObj *task)
+{
+    QTaskObj *_task;
+
+    if(_task_state(sched, task) == QTASK_STATE_ONESHOT) {
+        return -1;
+    }
+    _task = _hash_find(sched, task->id, task->name);
+    if(_task == task && task->state == QTASK_STATE_SCHED) {
+        _task_park(sched, task);
+        QTASK_TRACE(sched, QTASK_TRACE_DEL, task->trace_key);
+        QTASK_RECORD(sched, QTASK_REC_DEL, task, 0);
+        return 0;
+    }
+    if(_task == QNULL) {
+        // Never added, park it so that it can be resumed by name
+        _hash_insert(sched, task);
+        task->isready = 0;
+#if QTASK_USING_EDF
+        task->heap_idx = 0;
+#endif
+#if QTASK_USING_ABSOLUTE
+        task->release_tick = sched->tick;
+#endif
+        task->state = QTASK_STATE_SUSPEND;
+        task->owner = sched;
+        _task_nodes_init(task);
+        QTASK_CRITICAL_ENTER();
+        _list_insert(&sched->suspend_list, &task->task_node);
+        QTASK_CRITICAL_EXIT();
+        QTASK_TRACE(sched, QTASK_TRACE_DEL, task->trace_key);
+        // Replayed as an add followed by a del
+        QTASK_RECORD(sched, QTASK_REC_ADD, task, 0);
+        QTASK_RECORD(sched, QTASK_REC_DEL, task, 0);
+        return 0;
+    }
+    return -1;
+}
+
+int qtask_suspend(QTaskSched *sched, const char *name)
+{
+    QTaskObj *task = _hash_find(sched, _id_calc(name), name);
+
+    if(task == QNULL || task->state != QTASK_STATE_SCHED) {
+        return -1;
+    }
+    _task_park(sched, task);
+    QTASK_TRACE(sched, QTASK_TRACE_SUSPEND, task->trace_key);
+    QTASK_RECORD(sched, QTASK_REC_SUSPEND, task, 0);
+    return 0;
+}
+
+int qtask_resume(QTaskSched *sched, const char *name)
+{
+    QTaskObj *task = _hash_find(sched, _id_calc(name), name);
+
+    if(task == QNULL || task->state != QTASK_STATE_SUSPEND) {
+        return -1;
+    }
+    QTASK_RECORD(sched, QTASK_REC_CONFIG, task, 0);
+    task->isready = 0;
+    QTASK_CRITICAL_ENTER();
+    task->timer = task->period;
+    _list_remove(&task->task_node);
+    _list_insert(&sched->task_list, &task->task_node);
+    task->state = QTASK_STATE_SCHED;
+    QTASK_CRITICAL_EXIT();
+#if QTASK_USING_WHEEL
+    task->seq = ++sched->seq;
+#endif
+#if QTASK_USING_ABSOLUTE
+    // Back on the grid the task had before it was suspended
+    _timer_start(sched, task, _release_align(sched, task, 1));
+#else
+    _timer_start(sched, task, task->period);
+#endif
+    QTASK_TRACE(sched, QTASK_TRACE_RESUME, task->trace_key);
+    QTASK_RECORD(sched, QTASK_REC_RESUME, task, 0);
+    return 0;
+}
+
+int qtask_defer(QTaskSched *sched, QTaskObj *task, QTaskHandleCtx handle, void *ctx, size_t delay)
+{
+    uint8_t state = _task_state(sched, task);
+
+    if(state == QTASK_STATE_SCHED || state == QTASK_STATE_SUSPEND) {
+        return -1;
+    }
+    if(state == QTASK_STATE_ONESHOT) {
+        task->handle_ctx = handle;
+        task->ctx = ctx;
+    } else {
+#if !QTASK_USING_WHEEL && QTASK_TICK_SCAN_MAX > 0
+        // The list backend would never count it down
+        if(sched->defer_num >= QTASK_TICK_SCAN_MAX) {
+            return -1;
+        }
+#endif
+        // Anonymous, nothing to hash, traces tell calls apart by their key
+        _task_init(task, QNULL, (uint32_t)(uintptr_t)task, QNULL, handle, ctx, 0);
+#if QTASK_USING_TRACE
+        task->trace_key = ++sched->trace_keys;
+#endif
+        _task_nodes_init(task);
+        task->state = QTASK_STATE_ONESHOT;
+        task->owner = sched;
+    }
+    QTASK_TRACE(sched, QTASK_TRACE_ADD, task->trace_key);
+
+    // One critical section, an expiry of the old delay must not slip in before the restart
+    QTASK_CRITICAL_ENTER();
+    if(state == QTASK_STATE_ONESHOT) {
+        // Restart, an expiry still waiting to run is dropped
+        _ready_detach(sched, task);
+    } else {
+        // Appended so that the scan bound of the list backend reaches periodic tasks first
+        _list_insert(sched->task_list.prev, &task->task_node);
+#if QTASK_USING_WHEEL
+        task->seq = ++sched->seq;
+#endif
+        sched->defer_num++;
+    }
+    QTASK_RECORD_IRQ(sched, QTASK_REC_DEFER, task, delay);
+    if(delay > 0) {
+        _timer_arm(sched, task, delay);
+    } else {
+        _timer_unlink(task);
+        task->timer = 0;
+        _ready_push(sched, task, 1);
+    }
+    QTASK_CRITICAL_EXIT();
+    return 0;
+}
+
+int qtask_cancel(QTaskSched *sched, QTaskObj *task)
+{
+    if(_task_state(sched, task) != QTASK_STATE_ONESHOT) {
+        return -1;
+    }
+    _oneshot_unlink(sched, task);
+    QTASK_TRACE(sched, QTASK_TRACE_DEL, task->trace_key);
+    QTASK_RECORD(sched, QTASK_REC_CANCEL, task, 0);
+    return 0;
+}
+
+QTaskObj *qtask_obj(QTaskSched *sched, const char *taskname)
+{
+    QTaskObj *task = _hash_find(sched, _id_calc(taskname), taskname);
+
+    if(task == QNULL || task->state != QTASK_STATE_SCHED) {
+        return QNULL;
+    }
+    return task;
+}
+
+#if QTASK_USING_STATS
+static inline int _hist_bucket(uint32_t value)
+{
+    int bucket = value ? _log2(value) + 1 : 0;
+    return (bucket < QTASK_STATS_HIST_SIZE) ? bucket : QTASK_STATS_HIST_SIZE - 1;
+}
+
+static void _stats_update(QTaskStats *stats, uint32_t rtime)
+{
+    double delta;
+
+    stats->hist[_hist_bucket(rtime)]++;
+
+    if(stats->count == 0 || rtime < stats->min) {
+        stats->min = rtime;
+    }
+    if(rtime > stats->max) {
+        stats->max = rtime;
+    }
+    stats->count++;
+    delta = (double)rtime - stats->mean;
+    stats->mean += delta / (double)stats->count;
+    stats->m2 += delta * ((double)rtime - stats->mean);
+}
+
+static void _latency_update(QTaskStats *stats, uint32_t latency)
+{
+    stats->latency = latency;
+    if(latency > stats->latency_max) {
+        stats->latency_max = latency;
+    }
+    stats->latency_hist[_hist_bucket(latency)]++;
+}
+#endif
+
+#if QTASK_USING_DEADLINE
+static inline void _deadline_miss(QTaskObj *task, uint8_t kind)
+{
+    task->dmiss++;
+    if(task->miss_hook) {
+        task->miss_hook(task, kind);
+    }
+}
+#endif
+
+// Run the handler once, returns 0 if the handler destroyed its task
+static int _dispatch(QTaskSched *sched, QTaskObj *task)
+{
+    QTaskObj *outer = sched->run_task;
+#if QTASK_USING_TRACE
+    uint32_t key = task->trace_key;
+#endif
+    uint32_t start = 0;
+#if QTASK_USING_DEADLINE
+    int late = task->dl_check && sched->tick > task->abs_deadline;
+
+    if(late) {
+        _deadline_miss(task, QTASK_MISS_START);
+    }
+#endif
+    sched->run_task = task;
+    if(sched->clock) {
+        start = sched->clock();
+        sched->run_start = start;
+#if QTASK_USING_STATS
+        _latency_update(&task->stats, start - task->release);
+#endif
+    }
+    QTASK_TRACE(sched, QTASK_TRACE_START, task->trace_key);
+    if(task->handle_ctx) {
+        task->handle_ctx(task->ctx);
+    } else {
+        task->handle();
+    }
+    QTASK_TRACE(sched, QTASK_TRACE_END, key);
+    QTASK_RECORD(sched, QTASK_REC_END, QNULL, 0);
+    if(sched->run_task != task) {
+        // The slot may already hold the next task created in it
+        sched->run_task = outer;
+        return 0;
+    }
+    // run_start rather than start, qtask_yield moves it past the time of nested handlers
+    task->rtime = sched->clock ? (size_t)(uint32_t)(sched->clock() - sched->run_start) : task->rtick;
+#if QTASK_USING_STATS
+    _stats_update(&task->stats, (uint32_t)task->rtime);
+#endif
+#if QTASK_USING_LOAD
+    if(sched->clock) {
+        sched->load_acc += (uint32_t)task->rtime;
+        task->cpu_time += task->rtime;
+    }
+#endif
+#if QTASK_USING_DEADLINE
+    if(!late && task->dl_check && sched->tick > task->abs_deadline) {
+        _deadline_miss(task, QTASK_MISS_FINISH);
+    }
+#endif
+    task->rtick = 0;
+    sched->run_task = outer;
+    return 1;
+}
+
+// Run a dequeued task for its pending activations according to its overrun policy
+static void _activate(QTaskSched *sched, QTaskObj *task, uint16_t pending)
+{
+    uint16_t runs = 1;
+
+#if QTASK_USING_OVERRUN
+    if(pending > 1) {
+        switch(task->overrun) {
+        case QTASK_OVERRUN_SKIP:
+            runs = 0;
+            break;
+        case QTASK_OVERRUN_CATCHUP:
+            runs = (pending < task->catchup) ? pending : task->catchup;
+            break;
+        default:
+            break;
+        }
+        task->missed += pending - runs;
+    }
+#else
+    (void)pending;
+#endif
+
+    while(runs--) {
+        if(!_dispatch(sched, task)) {
+            return;
+        }
+        if(task->state != QTASK_STATE_SCHED && task->state != QTASK_STATE_ONESHOT) {
+            break;
+        }
+    }
+
+    // A one-shot call that its handler did not arm again is done
+    if(task->state == QTASK_STATE_ONESHOT && task->timer == 0 && !task->isready) {
+        QTASK_CRITICAL_ENTER();
+        _list_remove(&task->task_node);
+        sched->defer_num--;
+        QTASK_CRITICAL_EXIT();
+        task->state = QTASK_STATE_NONE;
+        task->owner = QNULL;
+    }
+}
+
+#if QTASK_USING_LOAD
+// Close the current load window once it spans QTASK_LOAD_WINDOW ticks
+static void _load_update(QTaskSched *sched)
+{
+    uint32_t now;
+
+    if(!sched->clock || sched->tick - sched->load_tick < QTASK_LOAD_WINDOW) {
+        return;
+    }
+    now = sched->clock();
+    sched->load_busy[sched->load_idx] = sched->load_acc;
+    sched->load_total[sched->load_idx] = now - sched->load_start;
+    sched->load_elapsed += now - sched->load_start;
+    sched->load_idx = (sched->load_idx + 1) % QTASK_LOAD_SLOTS;
+    sched->load_tick = sched->tick;
+    sched->load_start = now;
+    sched->load_acc = 0;
+}
+#endif
+
+void qtask_exec(QTaskSched *sched)
+{
+    QTaskObj *task;
+    uint16_t pending;
+
+#if QTASK_USING_LOAD
+    _load_update(sched);
+#endif
+
+#if QTASK_USING_IDLE
+    // Whatever the sleep released runs right away
+    if(sched->idle && !qtask_pending(sched)) {
+        sched->idle(qtask_tick_next(sched));
+    }
+#endif
+
+    while((task = _ready_pop(sched, &pending, QNULL)) != QNULL) {
+        _activate(sched, task, pending);
+    }
+}
+
+QTaskObj *qtask_exec_once(QTaskSched *sched)
+{
+    QTaskObj *task;
+    uint16_t pending;
+
+#if QTASK_USING_LOAD
+    _load_update(sched);
+#endif
+
+    task = _ready_pop(sched, &pending, QNULL);
+    if(task) {
+        _activate(sched, task, pending);
+    }
+    return task;
+}
+
+int qtask_yield(QTaskSched *sched)
+{
+    QTaskObj *self = sched->run_task;
+    QTaskObj *task;
+    uint32_t start = sched->run_start;
+    uint32_t now = sched->clock ? sched->clock() : 0;
+    uint16_t pending;
+    int runs = 0;
+
+    if(self == QNULL) {
+        return 0;
+    }
+    while((task = _ready_pop(sched, &pending, self)) != QNULL) {
+        _activate(sched, task, pending);
+        runs++;
+    }
+    // Time spent in nested handlers is theirs, not the caller's
+    if(runs && sched->clock) {
+        sched->run_start = start + (sched->clock() - now);
+    }
+    return runs;
+}
+
+int qtask_pending(QTaskSched *sched)
+{
+#if QTASK_USING_EDF
+    return sched->ready_map != 0 || sched->edf_num != 0;
+#else
+    return sched->ready_map != 0;
+#endif
+}
+
+#if QTASK_USING_WHEEL
+void qtask_tick_increase(QTaskSched *sched)
+{
+    QTaskList expired;
+    QTaskList *slot;
+    QTaskObj *task;
+    uint64_t tick = ++sched->tick;
+
+    QTASK_TRACE(sched, QTASK_TRACE_TICK, (uint32_t)tick);
+    QTASK_RECORD_IRQ(sched, QTASK_REC_TICK, QNULL, 0);
+
+    // Pull the next lower level into range every time a level wraps
+    for(int level = 1; level < QTASK_WHEEL_LEVELS; level++) {
+        if((tick >> (QTASK_WHEEL_BITS * (level - 1))) & QTASK_WHEEL_MASK) {
+            break;
+        }
+        _wheel_cascade(sched, level);
+    }
+
+    // Detach the slot first, tasks re-armed below may land in it again a full turn later
+    slot = &sched->wheel[0][tick & QTASK_WHEEL_MASK];
+    if(slot->next == slot) {
+        return;
+    }
+    expired.next = slot->next;
+    expired.prev = slot->prev;
+    expired.next->prev = &expired;
+    expired.prev->next = &expired;
+    slot->next = slot->prev = slot;
+    if(sched->wheel_mixed[tick & QTASK_WHEEL_MASK]) {
+        sched->wheel_mixed[tick & QTASK_WHEEL_MASK] = 0;
+        _wheel_sort(&expired);
+    }
+
+    while(expired.next != &expired) {
+        task = QTASK_ENTRY(expired.next, QTaskObj, timer_node);
+        _list_remove(&task->timer_node);
+#if QTASK_USING_ABSOLUTE
+        _ready_push(sched, task, _release_expire(sched, task));
+        if(task->timer > 0) {
+            task->expire = task->release_tick;
+            _wheel_insert(sched, task);
+        }
+#else
+        _ready_push(sched, task, 1);
+        task->timer = task->period;
+        if(task->period > 0) {
+            task->expire = tick + task->period;
+            _wheel_insert(sched, task);
+        }
+#endif
+    }
+}
+#else
+static inline void _timer_count(QTaskSched *sched, QTaskObj *task)
+{
+    if(task->timer > 0) {
+        if(--task->timer <= 0) {
+#if QTASK_USING_ABSOLUTE
+            _ready_push(sched, task, _release_expire(sched, task));
+#else
+            _ready_push(sched, task, 1);
+            task->timer = task->period;
+#endif
+        }
+    }
+}
+
+void qtask_tick_increase(QTaskSched *sched)
+{
+    QTaskList *node, *safe;
+    QTaskObj *task;
+#if QTASK_TICK_SCAN_MAX > 0
+    size_t count = 0;
+#endif
+
+    sched->tick++;
+    QTASK_TRACE(sched, QTASK_TRACE_TICK, (uint32_t)sched->tick);
+    QTASK_RECORD_IRQ(sched, QTASK_REC_TICK, QNULL, 0);
+
+    QTASK_ITERATOR_SAFE(node, safe, &sched->task_list)
+    {
+        if(node == QNULL || node->next == QNULL || node->prev == QNULL) {
+            return;
+        }
+
+        task = QTASK_ENTRY(node, QTaskObj, task_node);
+        if(task == QNULL) {
+            return;
+        }
+        if(task->state == QTASK_STATE_ONESHOT) {
+            break;
+        }
+        _timer_count(sched, task);
+#if QTASK_TICK_SCAN_MAX > 0
+        if(++count >= QTASK_TICK_SCAN_MAX) {
+            break;
+        }
+#endif
+    }
+
+    // One-shot calls are appended, the tail holds all of them, qtask_defer keeps them within the bound
+    for(node = sched->task_list.prev; node != &sched->task_list; node = safe) {
+        safe = node->prev;
+        task = QTASK_ENTRY(node, QTaskObj, task_node);
+        if(task->state != QTASK_STATE_ONESHOT) {
+            break;
+        }
+        _timer_count(sched, task);
+    }
+}
+#endif
+
+#if QTASK_USING_WHEEL
+size_t qtask_tick_next(QTaskSched *sched)
+{
+    QTaskList *slot, *node;
+    QTaskObj *task;
+    uint64_t next = 0;
+    size_t idx;
+
+    if(qtask_pending(sched)) {
+        return 0;
+    }
+
+    QTASK_CRITICAL_ENTER();
+    // Slots of a level are visited in cascade order, the current slot only holds the next turn
+    for(int level = 0; level < QTASK_WHEEL_LEVELS; level++) {
+        idx = (size_t)(sched->tick >> (QTASK_WHEEL_BITS * level));
+        for(size_t i = 1; i <= QTASK_WHEEL_SIZE; i++) {
+            slot = &sched->wheel[level][(idx + i) & QTASK_WHEEL_MASK];
+            if(slot->next == slot) {
+                continue;
+            }
+            QTASK_ITERATOR(node, slot)
+            {
+                task = QTASK_ENTRY(node, QTaskObj, timer_node);
+                if(next == 0 || task->expire < next) {
+                    next = task->expire;
+                }
+            }
+            break;
+        }
+        // Timers on higher levels cannot expire before this level wraps
+        if(next != 0 && next <= (sched->tick | ((((uint64_t)1) << (QTASK_WHEEL_BITS * (level + 1))) - 1))) {
+            break;
+        }
+    }
+    QTASK_CRITICAL_EXIT();
+
+    if(next == 0) {
+        return QTASK_TICK_NONE;
+    }
+    return (next - sched->tick >= QTASK_TICK_NONE) ? QTASK_TICK_NONE - 1 : (size_t)(next - sched->tick);
+}
+
+void qtask_tick_advance(QTaskSched *sched, size_t n)
+{
+    // Empty ticks only cost a slot check, walking them keeps cascades exact
+    while(n--) {
+        qtask_tick_increase(sched);
+    }
+}
+#else
+size_t qtask_tick_next(QTaskSched *sched)
+{
+    QTaskList *node;
+    QTaskObj *task;
+    size_t next = QTASK_TICK_NONE;
+
+    if(qtask_pending(sched)) {
+        return 0;
+    }
+
+    QTASK_ITERATOR(node, &sched->task_list)
+    {
+        task = QTASK_ENTRY(node, QTaskObj, task_node);
+        if(task->timer > 0 && task->timer < next) {
+            next = task->timer;
+        }
+    }
+    return next;
+}
+
+void qtask_tick_advance(QTaskSched *sched, size_t n)
+{
+    QTaskList *node, *safe;
+    QTaskObj *task;
+#if !QTASK_USING_ABSOLUTE
+    size_t late;
+#endif
+
+    if(n == 0) {
+        return;
+    }
+    sched->tick += n;
+    QTASK_TRACE(sched, QTASK_TRACE_TICK, (uint32_t)sched->tick);
+    QTASK_RECORD_IRQ(sched, QTASK_REC_ADVANCE, QNULL, n);
+
+    QTASK_ITERATOR_SAFE(node, safe, &sched->task_list)
+    {
+        task = QTASK_ENTRY(node, QTaskObj, task_node);
+        if(task->timer == 0) {
+            continue;
+        }
+        if(n < task->timer) {
+            task->timer -= n;
+            continue;
+        }
+        // Expired inside the window, keep the phase the per-tick countdown would have had
+#if QTASK_USING_ABSOLUTE
+        _ready_push(sched, task, _release_expire(sched, task));
+#else
+        late = n - task->timer;
+        _ready_push(sched, task, (task->period > 0) ? 1 + late / task->period : 1);
+        task->timer = (task->period > 0) ? task->period - late % task->period : 0;
+#endif
+    }
+}
+#endif
+
+void qtask_runtime_increase(QTaskSched *sched)
+{
+    QTaskObj *task = sched->run_task;
+
+    // Only the running handler is charged, time spent waiting in the ready queue is not
+    if(task) {
+        task->rtick++;
+    }
+}
+
+#if QTASK_USING_STATS
+void qtask_stats_get(QTaskObj *task, QTaskStats *stats)
+{
+    memcpy(stats, &task->stats, sizeof(QTaskStats));
+}
+
+void qtask_stats_reset(QTaskObj *task)
+{
+    memset(&task->stats, 0, sizeof(QTaskStats));
+}
+
+double qtask_stats_variance(const QTaskStats *stats)
+{
+    if(stats->count < 2) {
+        return 0;
+    }
+    return stats->m2 / (double)(stats->count - 1);
+}
+
+QTaskObj *qtask_latency_worst(QTaskSched *sched)
+{
+    QTaskList *node;
+    QTaskObj *task, *worst = QNULL;
+
+    QTASK_ITERATOR(node, &sched->task_list)
+    {
+        task = QTASK_ENTRY(node, QTaskObj, task_node);
+        if(task->stats.count && (!worst || task->stats.latency_max > worst->stats.latency_max)) {
+            worst = task;
+        }
+    }
+    return worst;
+}
+#endif
+
+#if QTASK_USING_LOAD
+uint16_t qtask_load_get(QTaskSched *sched, size_t windows)
+{
+    uint64_t busy = 0, total = 0;
+    size_t idx = sched->load_idx;
+
+    if(windows > QTASK_LOAD_SLOTS) {
+        windows = QTASK_LOAD_SLOTS;
+    }
+    while(windows--) {
+        idx = (idx + QTASK_LOAD_SLOTS - 1) % QTASK_LOAD_SLOTS;
+        busy += sched->load_busy[idx];
+        total += sched->load_total[idx];
+    }
+    return total ? (uint16_t)(busy * 1000 / total) : 0;
+}
+
+uint16_t qtask_load_task(QTaskSched *sched, QTaskObj *task)
+{
+    uint64_t total = sched->load_elapsed;
+
+    if(sched->clock) {
+        total += (uint32_t)(sched->clock() - sched->load_start);
+    }
+    return total ? (uint16_t)(task->cpu_time * 1000 / total) : 0;
+}
+
+void qtask_load_reset(QTaskSched *sched)
+{
+    QTaskList *node;
+
+    for(size_t i = 0; i < QTASK_LOAD_SLOTS; i++) {
+        sched->load_busy[i] = 0;
+        sched->load_total[i] = 0;
+    }
+    sched->load_idx = 0;
+    sched->load_tick = sched->tick;
+    sched->load_start = sched->clock ? sched->clock() : 0;
+    sched->load_acc = 0;
+    sched->load_elapsed = 0;
+    QTASK_ITERATOR(node, &sched->task_list)
+    {
+        QTASK_ENTRY(node, QTaskObj, task_node)->cpu_time = 0;
+    }
+}
+#endif
+
+#if QTASK_USING_TRACE
+void qtask_trace_enable(QTaskSched *sched, uint8_t enable)
+{
+    sched->trace_on = enable;
+}
+
+static void _trace_put(QTaskTraceWrite write, void *arg, uint32_t value, size_t len)
+{
+    uint8_t buf[4];
+
+    for(size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(value >> (8 * i));
+    }
+    write(buf, len, arg);
+}
+
+static void _trace_names(QTaskList *list, QTaskTraceWrite write, void *arg)
+{
+    QTaskList *node;
+    QTaskObj *task;
+    size_t len;
+
+    QTASK_ITERATOR(node, list)
+    {
+        task = QTASK_ENTRY(node, QTaskObj, task_node);
+        len = task->name ? strlen(task->name) : 0;
+        len = (len > 255) ? 255 : len;
+        _trace_put(write, arg, task->trace_key, 4);
+        _trace_put(write, arg, (uint32_t)len, 1);
+        if(len) {
+            write(task->name, len, arg);
+        }
+    }
+}
+
+void qtask_trace_dump(QTaskSched *sched, QTaskTraceWrite write, void *arg)
+{
+    QTaskList *node;
+    QTaskTraceEvt *evt;
+    uint32_t names = 0;
+    uint32_t head = sched->trace_head;
+    uint32_t count = (head < QTASK_TRACE_SIZE) ? head : QTASK_TRACE_SIZE;
+
+    QTASK_ITERATOR(node, &sched->task_list)
+    {
+        names++;
+    }
+    QTASK_ITERATOR(node, &sched->suspend_list)
+    {
+        names++;
+    }
+
+    write("QTRC", 4, arg);
+    _trace_put(write, arg, QTASK_TRACE_VERSION, 2);
+    _trace_put(write, arg, sched->clock ? QTASK_TRACE_FLAG_CLOCK : 0, 2);
+    _trace_put(write, arg, names, 4);
+    _trace_put(write, arg, count, 4);
+    _trace_names(&sched->task_list, write, arg);
+    _trace_names(&sched->suspend_list, write, arg);
+
+    for(uint32_t i = head - count; i != head; i++) {
+        evt = &sched->trace[i & (QTASK_TRACE_SIZE - 1)];
+        _trace_put(write, arg, evt->time, 4);
+        _trace_put(write, arg, evt->key, 4);
+        _trace_put(write, arg, evt->type, 1);
+    }
+}
+#endif
+
+#if QTASK_USING_RECORD
+int qtask_record_start(QTaskSched *sched, QTaskTraceWrite write, void *arg)
+{
+    uint8_t buf[32];
+    size_t len = 4;
+    uint16_t flags = 0;
+
+    if(sched->task_list.next != &sched->task_list || sched->suspend_list.next != &sched->suspend_list) {
+        return -1;
+    }
+#if QTASK_USING_WHEEL
+    flags |= QTASK_REC_FLAG_WHEEL;
+#endif
+#if QTASK_USING_EDF
+    flags |= QTASK_REC_FLAG_EDF;
+#endif
+#if QTASK_USING_ABSOLUTE
+    flags |= QTASK_REC_FLAG_ABSOLUTE;
+#endif
+    memcpy(buf, "QREC", 4);
+    len += _rec_put(&buf[len], QTASK_REC_VERSION, 2);
+    len += _rec_put(&buf[len], flags, 2);
+    len += _rec_put(&buf[len], QTASK_PRIO_NUM, 2);
+    len += _rec_put(&buf[len], QTASK_TICK_SCAN_MAX, 4);
+    len += _rec_put(&buf[len], QTASK_EDF_HEAP_SIZE, 4);
+    len += _rec_put(&buf[len], sched->tick, 8);
+    buf[len++] = sched->policy;
+    write(buf, len, arg);
+
+    QTASK_CRITICAL_ENTER();
+    sched->record_arg = arg;
+    sched->record = write;
+    QTASK_CRITICAL_EXIT();
+    return 0;
+}
+
+void qtask_record_stop(QTaskSched *sched)
+{
+    QTASK_CRITICAL_ENTER();
+    sched->record = QNULL;
+    QTASK_CRITICAL_EXIT();
+}
+#endif
+
+void qtask_clock_set(QTaskSched *sched, QTaskClock clock)
+{
+    sched->clock = clock;
+#if QTASK_USING_LOAD
+    sched->load_start = clock ? clock() : 0;
+    sched->load_acc = 0;
+#endif
+}
+
+#if QTASK_USING_IDLE
+void qtask_idle_set(QTaskSched *sched, QTaskIdleHook hook)
+{
+    sched->idle = hook;
+}
+#endif
+
+#if QTASK_USING_BUDGET
+uint32_t qtask_budget_remaining(QTaskSched *sched)
+{
+    QTaskObj *task = sched->run_task;
+    uint32_t used;
+
+    if(task == QNULL || task->budget == 0) {
+        return UINT32_MAX;
+    }
+    used = sched->clock ? sched->clock() - sched->run_start : (uint32_t)task->rtick;
+    return (used < task->budget) ? task->budget - used : 0;
+}
+
+int qtask_should_yield(QTaskSched *sched)
+{
+    return qtask_budget_remaining(sched) == 0;
+}
+#endif
+
+void qtask_sleep(QTaskSched *sched, size_t tick)
+{
+    if(sched->run_task) {
+#if QTASK_USING_ABSOLUTE
+        // The grid depends on the period, replay needs it before the sleep
+        QTASK_RECORD(sched, QTASK_REC_CONFIG, sched->run_task, 0);
+        if(tick > 0) {
+            tick = _release_align(sched, sched->run_task, tick);
+        }
+#endif
+        _timer_start(sched, sched->run_task, tick);
+        QTASK_RECORD(sched, QTASK_REC_SLEEP, QNULL, tick);
+    }
+}
+
+// Ticks until the next release of a task, 0 when its timer is idle
+static size_t _timer_left(QTaskSched *sched, QTaskObj *task)
+{
+#if QTASK_USING_WHEEL
+    if(task->timer_node.next == &task->timer_node) {
+        return 0;
+    }
+    return (size_t)(task->expire - sched->tick);
+#else
+    (void)sched;
+    return task->timer;
+#endif
+}
+
+int qtask_phase_set(QTaskSched *sched, QTaskObj *task, size_t phase)
+{
+    size_t delay;
+
+    if(_task_state(sched, task) != QTASK_STATE_SCHED || task->period == 0 || phase >= task->period) {
+        return -1;
+    }
+    delay = (phase + task->period - (size_t)(sched->tick % task->period)) % task->period;
+    QTASK_RECORD(sched, QTASK_REC_CONFIG, task, 0);
+    _timer_start(sched, task, delay ? delay : task->period);
+    QTASK_RECORD(sched, QTASK_REC_PHASE, task, phase);
+    return 0;
+}
+
+static uint64_t _phase_weight(QTaskObj *task, uint8_t mode)
+{
+    if(mode != QTASK_PHASE_LOAD) {
+        return 1;
+    }
+#if QTASK_USING_STATS
+    if(task->stats.count) {
+        return task->stats.max ? task->stats.max : 1;
+    }
+#endif
+    return task->rtime ? task->rtime : 1;
+}
+
+// Load released offset ticks from now by every armed task except the one being planned
+static uint64_t _phase_load(QTaskSched *sched, QTaskObj *self, size_t offset, uint8_t mode)
+{
+    QTaskList *node;
+    QTaskObj *task;
+    uint64_t load = 0;
+    size_t left;
+
+    QTASK_ITERATOR(node, &sched->task_list)
+    {
+        task = QTASK_ENTRY(node, QTaskObj, task_node);
+        left = _timer_left(sched, task);
+        if(task == self || left == 0 || offset < left) {
+            continue;
+        }
+        if(offset == left || (task->period > 0 && (offset - left) % task->period == 0)) {
+            load += _phase_weight(task, mode);
+        }
+    }
+    return load;
+}
+
+static size_t _gcd(size_t a, size_t b)
+{
+    size_t t;
+
+    while(b) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+size_t qtask_phase_auto(QTaskSched *sched, QTaskObj *task, uint8_t mode)
+{
+    QTaskList *node;
+    QTaskObj *other;
+    size_t horizon, best = 0, offset;
+    uint64_t load, peak, sum, best_peak = UINT64_MAX, best_sum = UINT64_MAX;
+
+    if(_task_state(sched, task) != QTASK_STATE_SCHED || task->period == 0) {
+        return QTASK_TICK_NONE;
+    }
+
+    // Hyperperiod of the task set, bounded by the planning horizon
+    horizon = task->period;
+    QTASK_ITERATOR(node, &sched->task_list)
+    {
+        other = QTASK_ENTRY(node, QTaskObj, task_node);
+        if(other->period == 0 || horizon >= QTASK_PHASE_HORIZON) {
+            continue;
+        }
+        horizon = horizon / _gcd(horizon, other->period) * other->period;
+    }
+    if(horizon > QTASK_PHASE_HORIZON) {
+        horizon = (task->period > QTASK_PHASE_HORIZON) ? task->period : QTASK_PHASE_HORIZON;
+    }
+
+    // Every tick of the horizon is visited once over all phases
+    for(size_t phase = 0; phase < task->period; phase++) {
+        offset = (phase + task->period - (size_t)(sched->tick % task->period)) % task->period;
+        peak = 0;
+        sum = 0;
+        for(offset = offset ? offset : task->period; offset <= horizon; offset += task->period) {
+            load = _phase_load(sched, task, offset, mode);
+            peak = (load > peak) ? load : peak;
+            sum += load;
+        }
+        if(peak < best_peak || (peak == best_peak && sum < best_sum)) {
+            best_peak = peak;
+            best_sum = sum;
+            best = phase;
+        }
+    }
+    qtask_phase_set(sched, task, best);
+    return best;
+}
+
+int qtask_prio_set(QTaskSched *sched, QTaskObj *task, uint8_t prio)
+{
+    if(prio >= QTASK_PRIO_NUM) {
+        return -1;
+    }
+
+    QTASK_CRITICAL_ENTER();
+    QTASK_RECORD_IRQ(sched, QTASK_REC_PRIO, task, prio);
+    if(task->ready_node.next != &task->ready_node) {
+        _ready_unlink(sched, task);
+        task->priority = prio;
+        _list_insert(sched->ready_list[prio].prev, &task->ready_node);
+        sched->ready_map |= (uint32_t)1 << prio;
+    } else {
+        task->priority = prio;
+    }
+    QTASK_CRITICAL_EXIT();
+    return 0;
+}
+
+int qtask_policy_set(QTaskSched *sched, uint8_t policy)
+{
+    if(policy == QTASK_POLICY_PRIO) {
+        sched->policy = policy;
+        QTASK_RECORD(sched, QTASK_REC_POLICY, QNULL, policy);
+        return 0;
+    }
+#if QTASK_USING_EDF
+    if(policy == QTASK_POLICY_EDF) {
+        sched->policy = policy;
+        QTASK_RECORD(sched, QTASK_REC_POLICY, QNULL, policy);
+        return 0;
+    }
+#endif
+    return -1;
+}
+
+#if QTASK_USING_OVERRUN
+int qtask_overrun_set(QTaskObj *task, uint8_t policy, uint16_t catchup)
+{
+    if(policy > QTASK_OVERRUN_CATCHUP || (policy == QTASK_OVERRUN_CATCHUP && catchup == 0)) {
+        return -1;
+    }
+    task->overrun = policy;
+    task->catchup = (policy == QTASK_OVERRUN_CATCHUP) ? catchup : 1;
+#if QTASK_USING_RECORD
+    task->recfg = 1;
+#endif
+    return 0;
+}
+#endif
+
+#if QTASK_USING_EDF || QTASK_USING_DEADLINE
+void qtask_deadline_set(QTaskObj *task, size_t tick)
+{
+    task->deadline = tick;
+#if QTASK_USING_RECORD
+    task->recfg = 1;
+#endif
+}
+#endif
+
+#if QTASK_USING_DEADLINE
+void qtask_miss_hook_set(QTaskObj *task, QTaskMissHook hook)
+{
+    task->miss_hook = hook;
+}
+#endif
+
+#if QTASK_USING_BUDGET
+void qtask_budget_set(QTaskObj *task, uint32_t budget)
+{
+    task->budget = budget;
 }
+#endif
 
 void qtask_tick_set(QTaskObj *obj, size_t tick)
 {
     obj->period = tick;
+#if QTASK_USING_RECORD
+    obj->recfg = 1;
+#endif
 }
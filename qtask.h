@@ -19,6 +19,354 @@
 #define QNULL ((void *)0)
 #endif
 
+/**
+ * @brief Timer backend selection.
+ *
+ * 0: every tick walks the scheduled task list and counts down each task timer, O(n) per tick.
+ * 1: task timers are kept in a hierarchical timing wheel, a tick only touches the expiring slot
+ *    and cascades one higher level slot every QTASK_WHEEL_SIZE ticks, O(1) amortized per tick.
+ */
+#ifndef QTASK_USING_WHEEL
+#define QTASK_USING_WHEEL       0
+#endif
+
+/**
+ * @brief Bound on the number of tasks the list backend visits per tick, 0 for no bound.
+ *
+ * Keeps the tick interrupt time bounded, tasks beyond the bound are not counted down. One-shot
+ * calls of qtask_defer have a bound of the same size of their own. Use the timing wheel for large
+ * task sets instead of raising it.
+ */
+#ifndef QTASK_TICK_SCAN_MAX
+#define QTASK_TICK_SCAN_MAX     1001
+#endif
+
+/**
+ * @brief Timing wheel geometry, each level has 2^QTASK_WHEEL_BITS slots.
+ *
+ * Timers farther than 2^(QTASK_WHEEL_BITS * QTASK_WHEEL_LEVELS) ticks are parked in the last level
+ * and re-cascaded until they come into range.
+ */
+#ifndef QTASK_WHEEL_BITS
+#define QTASK_WHEEL_BITS        6
+#endif
+
+#ifndef QTASK_WHEEL_LEVELS
+#define QTASK_WHEEL_LEVELS      4
+#endif
+
+/**
+ * @brief Absolute release mode.
+ *
+ * 0: a task timer is reloaded with the period when it expires, a late expiry, a qtask_sleep or a
+ *    tick left uncounted by QTASK_TICK_SCAN_MAX moves every later release.
+ * 1: each task keeps the tick of its next release and the following one is that tick plus the
+ *    period, releases stay on the grid fixed when the task was armed. Late expiries count every
+ *    release they passed, qtask_sleep and qtask_resume wake up on the grid, and a period change
+ *    applies from the release that is already armed.
+ */
+#ifndef QTASK_USING_ABSOLUTE
+#define QTASK_USING_ABSOLUTE    0
+#endif
+
+/**
+ * @brief Number of task priority levels, at most 32.
+ *
+ * Each level has its own ready list and a bit in a 32-bit ready map, the highest ready level is
+ * found with a single count-leading-zeros. A larger value means a higher priority. Every level
+ * costs a list head in the scheduler, raise it only when the task set needs more levels.
+ */
+#ifndef QTASK_PRIO_NUM
+#define QTASK_PRIO_NUM          8
+#endif
+
+#if QTASK_PRIO_NUM > 32 || QTASK_PRIO_NUM < 1
+#error "QTASK_PRIO_NUM must be in range 1..32"
+#endif
+
+/**
+ * @brief Earliest-deadline-first support.
+ *
+ * When enabled a scheduler can be switched to QTASK_POLICY_EDF, ready tasks are then kept in a
+ * binary min-heap ordered by absolute deadline. The heap is a static array of QTASK_EDF_HEAP_SIZE
+ * entries and should be at least as large as the number of tasks, tasks released while it is full
+ * fall back to the priority ready lists and run after the heap is drained.
+ */
+#ifndef QTASK_USING_EDF
+#define QTASK_USING_EDF         0
+#endif
+
+#ifndef QTASK_EDF_HEAP_SIZE
+#define QTASK_EDF_HEAP_SIZE     32
+#endif
+
+/**
+ * @brief Deadline miss detection, see qtask_deadline_set.
+ *
+ * Activations that start or finish after their deadline are counted in QTaskObj::dmiss and
+ * reported to the miss hook. The relative deadline itself is also kept with QTASK_USING_EDF.
+ */
+#ifndef QTASK_USING_DEADLINE
+#define QTASK_USING_DEADLINE    0
+#endif
+
+/**
+ * @brief Overrun policies and backlog counting, see qtask_overrun_set.
+ *
+ * Releases of a task that is still waiting are counted and handled by its overrun policy, the
+ * dropped ones show in QTaskObj::missed. Without it they coalesce into a single run.
+ */
+#ifndef QTASK_USING_OVERRUN
+#define QTASK_USING_OVERRUN     0
+#endif
+
+/**
+ * @brief Size of the task index, a power of two, 0 disables it.
+ *
+ * Scheduled and suspended tasks are indexed by id in a static open addressing table so that
+ * lookups by name are O(1), keep it at least twice the task count for short probe sequences.
+ * Tasks added once it is full are still accepted, lookups that miss then walk the task lists.
+ * With 0, the default, lookups always walk the task lists, which is fine for the few tasks of a
+ * small target and saves a pointer per entry in every scheduler.
+ */
+#ifndef QTASK_HASH_SIZE
+#define QTASK_HASH_SIZE         0
+#endif
+
+#if (QTASK_HASH_SIZE & (QTASK_HASH_SIZE - 1)) != 0
+#error "QTASK_HASH_SIZE must be a power of two"
+#endif
+
+/**
+ * @brief Per task execution time statistics, see QTaskStats.
+ */
+#ifndef QTASK_USING_STATS
+#define QTASK_USING_STATS       0
+#endif
+
+/**
+ * @brief Number of log2 histogram buckets, bucket n counts run times in [2^(n-1), 2^n), bucket 0
+ *        counts zero and the last bucket collects everything above.
+ */
+#ifndef QTASK_STATS_HIST_SIZE
+#define QTASK_STATS_HIST_SIZE   32
+#endif
+
+/**
+ * @brief Scheduler CPU load accounting, needs a clock (see qtask_clock_set).
+ *
+ * Handler time and wall time are collected per window of QTASK_LOAD_WINDOW ticks in a ring of
+ * QTASK_LOAD_SLOTS windows. With a 1 kHz tick the defaults give 100 ms windows and let
+ * qtask_load_get report the load over the last 100 ms, 1 s and 10 s.
+ */
+#ifndef QTASK_USING_LOAD
+#define QTASK_USING_LOAD        0
+#endif
+
+#ifndef QTASK_LOAD_WINDOW
+#define QTASK_LOAD_WINDOW       100
+#endif
+
+#ifndef QTASK_LOAD_SLOTS
+#define QTASK_LOAD_SLOTS        100
+#endif
+
+/**
+ * @brief Idle hook, see qtask_idle_set.
+ *
+ * qtask_exec calls the hook when it finds no task ready so that the main loop can sleep until the
+ * next release instead of spinning. On Linux qtask_sched_init installs a hook that blocks in
+ * clock_nanosleep for that many ticks of QTASK_TICK_NS nanoseconds.
+ */
+#ifndef QTASK_USING_IDLE
+#define QTASK_USING_IDLE        0
+#endif
+
+/**
+ * @brief Cooperative run time budgets, see qtask_budget_set.
+ */
+#ifndef QTASK_USING_BUDGET
+#define QTASK_USING_BUDGET      0
+#endif
+
+#ifndef QTASK_TICK_NS
+#define QTASK_TICK_NS           1000000
+#endif
+
+/**
+ * @brief Scheduler event trace ring, see qtask_trace_dump.
+ *
+ * Events are written into a QTASK_TRACE_SIZE entry ring (a power of two) that silently overwrites
+ * the oldest entries, each event costs a clock read, an index increment and three stores.
+ */
+#ifndef QTASK_USING_TRACE
+#define QTASK_USING_TRACE       0
+#endif
+
+#ifndef QTASK_TRACE_SIZE
+#define QTASK_TRACE_SIZE        256
+#endif
+
+#if (QTASK_TRACE_SIZE & (QTASK_TRACE_SIZE - 1)) != 0
+#error "QTASK_TRACE_SIZE must be a power of two"
+#endif
+
+/**
+ * @brief Deterministic record of scheduler activity, see qtask_record_start.
+ *
+ * Ticks, task management calls and dispatch decisions are written to an output function as they
+ * happen so that tools/qtask_replay.c can reproduce the exact dispatch order on a host.
+ */
+#ifndef QTASK_USING_RECORD
+#define QTASK_USING_RECORD      0
+#endif
+
+/**
+ * @brief Number of ticks qtask_phase_auto looks ahead, the hyperperiod of the task set is used
+ *        when it is shorter. Planning one task costs horizon * task count steps.
+ */
+#ifndef QTASK_PHASE_HORIZON
+#define QTASK_PHASE_HORIZON     4096
+#endif
+
+/**
+ * @brief Number of task slots in the static pool of each scheduler, 0 disables it.
+ *
+ * qtask_create takes a slot from a free list and qtask_destroy gives it back, both O(1) and
+ * without malloc. Slots are QTASK_CACHE_LINE aligned and contiguous, each holds the task and a
+ * copy of its name of up to QTASK_POOL_NAME_LEN - 1 characters. Size QTASK_HASH_SIZE for the pool
+ * tasks next to the caller allocated ones.
+ */
+#ifndef QTASK_POOL_SIZE
+#define QTASK_POOL_SIZE         0
+#endif
+
+#ifndef QTASK_POOL_NAME_LEN
+#define QTASK_POOL_NAME_LEN     16
+#endif
+
+#ifndef QTASK_CACHE_LINE
+#define QTASK_CACHE_LINE        64
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define QTASK_ALIGNED(n)        __attribute__((aligned(n)))
+#else
+#define QTASK_ALIGNED(n)
+#endif
+
+/**
+ * @brief Returned by qtask_tick_next when no task timer is armed.
+ */
+#define QTASK_TICK_NONE         ((size_t)-1)
+
+#define QTASK_WHEEL_SIZE        (1u << QTASK_WHEEL_BITS)
+#define QTASK_WHEEL_MASK        (QTASK_WHEEL_SIZE - 1)
+
+/**
+ * @brief Critical section hooks.
+ *
+ * qtask_tick_increase is usually called from a timer interrupt while the other APIs run in the
+ * main loop. Define these to disable/restore interrupts (or take a lock) on the target so that
+ * shared scheduler state is updated atomically, e.g. __disable_irq() / __enable_irq().
+ */
+#ifndef QTASK_CRITICAL_ENTER
+#define QTASK_CRITICAL_ENTER()
+#endif
+
+#ifndef QTASK_CRITICAL_EXIT
+#define QTASK_CRITICAL_EXIT()
+#endif
+
+/**
+ * @brief Task states, see QTaskObj::state.
+ */
+#define QTASK_STATE_NONE        0   /**< Not registered in any scheduler. */
+#define QTASK_STATE_SCHED       1   /**< Linked in the scheduled task list. */
+#define QTASK_STATE_SUSPEND     2   /**< Linked in the suspended task list. */
+#define QTASK_STATE_ONESHOT     3   /**< Armed one-shot call, linked in the scheduled task list but not indexed. */
+
+/**
+ * @brief Overrun policies, applied when a task was released again before it could run.
+ */
+#define QTASK_OVERRUN_ONCE      0   /**< Run once for all pending activations, the rest count as missed. */
+#define QTASK_OVERRUN_SKIP      1   /**< Drop the whole late backlog and wait for the next fresh release. */
+#define QTASK_OVERRUN_CATCHUP   2   /**< Run back to back for up to catchup pending activations. */
+
+/**
+ * @brief Deadline miss kinds passed to QTaskMissHook.
+ */
+#define QTASK_MISS_START        0   /**< The handler started after the deadline. */
+#define QTASK_MISS_FINISH       1   /**< The handler started in time but finished after the deadline. */
+
+/**
+ * @brief Trace event types, see QTaskTraceEvt.
+ */
+#define QTASK_TRACE_TICK        0   /**< Tick processed, key holds the low 32 bits of the tick count. */
+#define QTASK_TRACE_RELEASE     1   /**< Task released by its timer. */
+#define QTASK_TRACE_START       2   /**< Handler started. */
+#define QTASK_TRACE_END         3   /**< Handler returned. */
+#define QTASK_TRACE_SUSPEND     4   /**< Task suspended. */
+#define QTASK_TRACE_RESUME      5   /**< Task resumed. */
+#define QTASK_TRACE_ADD         6   /**< Task added. */
+#define QTASK_TRACE_DEL         7   /**< Task deleted. */
+
+/**
+ * @brief Trace dump format, written by qtask_trace_dump, all integers little endian.
+ *
+ * Header: "QTRC", u16 version, u16 flags (bit 0 set when times are clock readings, clear when
+ * they are tick counts), u32 number of names, u32 number of events.
+ * Names: u32 key, u8 length, name bytes. Events, oldest first: u32 time, u32 key, u8 type.
+ * Tasks are keyed by QTaskObj::trace_key rather than the name hash, which can collide.
+ */
+#define QTASK_TRACE_VERSION     2
+#define QTASK_TRACE_FLAG_CLOCK  0x0001
+
+/**
+ * @brief Record stream event types, each is a u8 type followed by the payload listed here.
+ */
+#define QTASK_REC_TICK          0   /**< qtask_tick_increase. */
+#define QTASK_REC_ADVANCE       1   /**< qtask_tick_advance, varint ticks. */
+#define QTASK_REC_DISPATCH      2   /**< Task dequeued for execution, varint key. */
+#define QTASK_REC_END           3   /**< Handler returned. */
+#define QTASK_REC_SUSPEND       4   /**< varint key. */
+#define QTASK_REC_RESUME        5   /**< varint key. */
+#define QTASK_REC_ADD           6   /**< varint key, u8 name length, name bytes, varint period. */
+#define QTASK_REC_DEL           7   /**< varint key. */
+#define QTASK_REC_PRIO          8   /**< varint key, u8 priority. */
+#define QTASK_REC_SLEEP         9   /**< qtask_sleep of the running task, varint ticks. */
+#define QTASK_REC_POLICY        10  /**< u8 policy. */
+#define QTASK_REC_CONFIG        11  /**< varint key, varint period, varint deadline, u8 overrun, varint catchup. */
+#define QTASK_REC_CONFIG_TICK   12  /**< Same payload, the change was made before the preceding tick released the task. */
+#define QTASK_REC_DEFER         13  /**< qtask_defer, varint key, varint delay. */
+#define QTASK_REC_CANCEL        14  /**< qtask_cancel, varint key. */
+#define QTASK_REC_PHASE         15  /**< qtask_phase_set, varint key, varint phase. */
+
+/**
+ * @brief Record stream format, integers are little endian and varints LEB128.
+ *
+ * Header: "QREC", u16 version, u16 flags (QTASK_REC_FLAG_xxx of the recording build),
+ * u16 QTASK_PRIO_NUM, u32 QTASK_TICK_SCAN_MAX, u32 QTASK_EDF_HEAP_SIZE, u64 tick, u8 policy.
+ * Events follow until the end of the stream. Tasks are keyed by the address of their object, ids
+ * are not unique and a name only exists once the task is added.
+ */
+#define QTASK_REC_VERSION       2
+#define QTASK_REC_FLAG_WHEEL    0x0001
+#define QTASK_REC_FLAG_EDF      0x0002
+#define QTASK_REC_FLAG_ABSOLUTE 0x0004
+
+/**
+ * @brief What qtask_phase_auto balances across ticks.
+ */
+#define QTASK_PHASE_COUNT       0   /**< Number of task releases. */
+#define QTASK_PHASE_LOAD        1   /**< Measured handler time, the worst run with QTASK_USING_STATS, the last one otherwise. */
+
+/**
+ * @brief Dispatch policies, see qtask_policy_set.
+ */
+#define QTASK_POLICY_PRIO       0   /**< Fixed priority, FIFO within a priority level. */
+#define QTASK_POLICY_EDF        1   /**< Earliest absolute deadline first. */
+
 /**
  * @struct QTaskList
  * @brief Represents a node in a doubly linked list.
@@ -30,6 +378,39 @@ typedef struct _task_list {
     struct _task_list* next; /**< Pointer to the next node in the list. */
 } QTaskList;
 
+/**
+ * @struct QTaskStats
+ * @brief Execution time statistics of a task, in clock units.
+ * 
+ * Updated by qtask_exec after every run without allocation, mean and m2 follow Welford's
+ * online algorithm so the variance is m2 / (count - 1). Both are double, in float the mean stops
+ * moving once count passes 2^24. The latency is measured from the clock reading taken when
+ * qtask_tick_increase releases the task to the start of its handler.
+ */
+typedef struct
+{
+    uint32_t count;         /**< Number of runs. */
+    uint32_t min;           /**< Shortest run. */
+    uint32_t max;           /**< Longest run. */
+    double mean;            /**< Running mean of the run time. */
+    double m2;              /**< Sum of squared differences from the running mean. */
+    uint32_t hist[QTASK_STATS_HIST_SIZE]; /**< Log2 histogram of run times. */
+    uint32_t latency;       /**< Release to start latency of the last run. */
+    uint32_t latency_max;   /**< Worst release to start latency. */
+    uint32_t latency_hist[QTASK_STATS_HIST_SIZE]; /**< Log2 histogram of release to start latencies. */
+} QTaskStats;
+
+struct _qtask;
+
+/**
+ * @typedef QTaskMissHook
+ * @brief Called from qtask_exec when a task misses its deadline.
+ * 
+ * Runs in the main loop right after the detection, keep it short, e.g. set a flag or lower the
+ * rate of a non-critical task.
+ */
+typedef void (*QTaskMissHook)(struct _qtask *task, uint8_t kind);
+
 /**
  * @struct QTaskObj
  * @brief Represents a task object.
@@ -40,24 +421,130 @@ typedef struct _task_list {
 typedef struct _qtask
 {
     const char* name;       /**< Name of the task. */
-    uint16_t id;            /**< Unique identifier of the task */
+    uint32_t id;            /**< Hash of the task name, identity is confirmed on the name itself. */
     uint8_t isready;        /**< Flag indicating whether the task is ready to execute. */
+#if QTASK_USING_DEADLINE
+    uint8_t dl_check;       /**< The pending activation was released with a deadline, checked for misses. */
+#endif
+    uint8_t state;          /**< Which scheduler list the task is linked in, QTASK_STATE_xxx. */
+    uint8_t priority;       /**< Dispatch priority, 0 is the lowest, QTASK_PRIO_NUM - 1 the highest. */
+    void *owner;            /**< Scheduler the task is linked in, state is only trusted when it matches. */
     void (*handle)(void); /**< Function pointer to the task's execution function. */
+    void (*handle_ctx)(void *ctx); /**< Execution function taking a context, used instead of handle when set. */
+    void *ctx;              /**< Context pointer passed to handle_ctx. */
     size_t timer;         /**< Timer value for the task, counting down to execution. */
     size_t period;          /**< Periodic tick value for the task. */
-    size_t rtime;         /**< Recorded execution time of the task. */
+    size_t rtime;         /**< Execution time of the last run, in clock units (rtick units without a clock). */
     size_t rtick;         /**< Running tick count of the task. */
+#if QTASK_USING_EDF || QTASK_USING_DEADLINE
+    size_t deadline;        /**< Relative deadline in ticks, 0 uses the period and disables miss detection. */
+    uint64_t abs_deadline;  /**< Absolute deadline tick of the current activation, kept with EDF or a deadline. */
+#endif
+#if QTASK_USING_EDF
+    size_t heap_idx;        /**< Position in the EDF heap plus one, 0 when not in the heap. */
+#endif
+#if QTASK_USING_OVERRUN
+    uint16_t pending;       /**< Activations released and not yet executed. */
+    uint8_t overrun;        /**< Overrun policy, QTASK_OVERRUN_xxx. */
+    uint16_t catchup;       /**< Maximum runs per dispatch under QTASK_OVERRUN_CATCHUP. */
+    uint32_t missed;        /**< Activations dropped by the overrun policy. */
+#endif
+#if QTASK_USING_DEADLINE
+    uint32_t dmiss;         /**< Activations that started or finished after their deadline. */
+    QTaskMissHook miss_hook; /**< Optional deadline miss callback. */
+#endif
+#if QTASK_USING_BUDGET
+    uint32_t budget;        /**< Run time the handler should stay within per run, in rtime units, 0 for none. */
+#endif
+#if QTASK_USING_RECORD
+    uint8_t recfg;          /**< Period, deadline or overrun policy changed since the last record of them. */
+#endif
+#if QTASK_USING_TRACE
+    uint32_t trace_key;     /**< Key of the task in trace events, unique per add on its scheduler. */
+#endif
     QTaskList task_node;    /**< Doubly linked list node for task scheduling. */
+    QTaskList ready_node;   /**< Ready queue node, linked while the task waits to be executed. */
+#if QTASK_USING_LOAD
+    uint64_t cpu_time;      /**< Handler time accumulated since the last qtask_load_reset. */
+#endif
+#if QTASK_USING_STATS
+    uint32_t release;       /**< Clock reading when the pending activation was released. */
+    QTaskStats stats;       /**< Execution time statistics. */
+#endif
+#if QTASK_USING_ABSOLUTE
+    uint64_t release_tick;  /**< Tick of the next release on the task grid. */
+#endif
+#if QTASK_USING_WHEEL
+    uint64_t expire;        /**< Absolute tick at which the task expires, used by the timing wheel. */
+    uint32_t seq;           /**< Task list insertion count, orders releases of the same tick. */
+    QTaskList timer_node;   /**< Timing wheel slot list node. */
+#endif
 } QTaskObj;
 
+/**
+ * @struct QTaskSlot
+ * @brief Task pool slot, see QTASK_POOL_SIZE.
+ */
+typedef struct
+{
+    QTaskObj obj;           /**< Task object, first so that a slot and its task share an address. */
+    char name[QTASK_POOL_NAME_LEN]; /**< Copy of the task name. */
+} QTASK_ALIGNED(QTASK_CACHE_LINE) QTaskSlot;
+
 /**
  * @typedef QTaskHandle
  * @brief Function pointer type for task execution functions.
  * 
- * Task execution functions should accept a void pointer as an argument.
+ * Task execution functions take no argument.
  */
 typedef void (*QTaskHandle)(void);
 
+/**
+ * @typedef QTaskHandleCtx
+ * @brief Function pointer type for task execution functions with a context.
+ * 
+ * The context pointer registered with the task is passed on every dispatch, so one function
+ * can serve many task instances.
+ */
+typedef void (*QTaskHandleCtx)(void *ctx);
+
+/**
+ * @struct QTaskTraceEvt
+ * @brief Trace ring entry.
+ */
+typedef struct
+{
+    uint32_t time;          /**< Clock reading, or low 32 bits of the tick count without a clock. */
+    uint32_t key;           /**< Task trace key, see QTASK_TRACE_TICK for tick events. */
+    uint8_t type;           /**< QTASK_TRACE_xxx. */
+} QTaskTraceEvt;
+
+/**
+ * @typedef QTaskTraceWrite
+ * @brief Output function used by qtask_trace_dump, e.g. a UART or file writer.
+ */
+typedef void (*QTaskTraceWrite)(const void *data, size_t len, void *arg);
+
+/**
+ * @typedef QTaskClock
+ * @brief High resolution clock used to time task handlers.
+ * 
+ * Returns a free running counter, e.g. a CPU cycle counter. Only differences are used, so the
+ * counter may wrap. It is also called from qtask_exec on every dispatch and must be cheap.
+ */
+typedef uint32_t (*QTaskClock)(void);
+
+/**
+ * @typedef QTaskIdleHook
+ * @brief Called by qtask_exec when no task is ready.
+ * 
+ * ticks is the qtask_tick_next value: the ticks until the next release, QTASK_TICK_NONE when no
+ * timer is armed, or 0 when a release came in after the ready check, the hook should then return
+ * at once. On a microcontroller it typically enters a wait-for-interrupt sleep, the tick interrupt
+ * wakes it up.
+ */
+typedef void (*QTaskIdleHook)(size_t ticks);
+
 /**
  * @struct QTaskSched
  * @brief Represents a task scheduler.
@@ -69,8 +556,55 @@ typedef struct
 {
     void *args;             /**< Arguments to be passed to the task. */
     QTaskObj *run_task;     /**< Pointer to the currently running task. */
+    QTaskClock clock;       /**< Clock used to time handlers, QNULL falls back to qtask_runtime_increase. */
+    uint32_t run_start;     /**< Clock reading when the running handler started. */
+#if QTASK_USING_IDLE
+    QTaskIdleHook idle;     /**< Called when qtask_exec finds nothing ready, QNULL to return at once. */
+#endif
     QTaskList task_list;   /**< Doubly linked list for scheduled tasks. */
     QTaskList suspend_list; /**< Doubly linked list for unscheduled tasks. */
+    QTaskList ready_list[QTASK_PRIO_NUM]; /**< Per priority FIFO of released tasks not yet executed. */
+    uint32_t ready_map;     /**< Bit n is set while ready_list[n] is not empty. */
+    uint8_t policy;         /**< Dispatch policy, QTASK_POLICY_PRIO or QTASK_POLICY_EDF. */
+#if QTASK_USING_EDF
+    QTaskObj *edf_heap[QTASK_EDF_HEAP_SIZE]; /**< Min-heap of ready tasks keyed by absolute deadline. */
+    size_t edf_num;         /**< Number of tasks in the EDF heap. */
+#endif
+    uint64_t tick;          /**< Monotonic count of processed ticks. */
+    size_t defer_num;       /**< Armed one-shot calls. */
+#if QTASK_HASH_SIZE > 0
+    QTaskObj *hash[QTASK_HASH_SIZE]; /**< Task index by id, covers scheduled and suspended tasks. */
+    uint32_t collisions;    /**< Number of tasks added whose id collided with a different name. */
+    uint32_t spilled;       /**< Tasks added while the index was full, only found by walking the lists. */
+#endif
+#if QTASK_USING_LOAD
+    uint32_t load_busy[QTASK_LOAD_SLOTS];  /**< Handler time of each closed window. */
+    uint32_t load_total[QTASK_LOAD_SLOTS]; /**< Wall time of each closed window. */
+    size_t load_idx;        /**< Ring slot the current window will be stored in. */
+    uint64_t load_tick;     /**< Tick at which the current window started. */
+    uint32_t load_start;    /**< Clock reading at which the current window started. */
+    uint32_t load_acc;      /**< Handler time accumulated in the current window. */
+    uint64_t load_elapsed;  /**< Wall time of the windows closed since the last qtask_load_reset. */
+#endif
+#if QTASK_USING_TRACE
+    QTaskTraceEvt trace[QTASK_TRACE_SIZE]; /**< Trace ring. */
+    uint32_t trace_head;    /**< Total number of events written, the ring index is its low bits. */
+    uint32_t trace_keys;    /**< Trace keys handed out so far. */
+    uint8_t trace_on;       /**< Recording enabled flag. */
+#endif
+#if QTASK_USING_RECORD
+    QTaskTraceWrite record; /**< Record stream output, QNULL while not recording. */
+    void *record_arg;       /**< Argument passed to the record output. */
+#endif
+#if QTASK_USING_WHEEL
+    QTaskList wheel[QTASK_WHEEL_LEVELS][QTASK_WHEEL_SIZE]; /**< Timing wheel slots, level 0 is the finest. */
+    uint8_t wheel_mixed[QTASK_WHEEL_SIZE]; /**< Level 0 slots filled out of release order. */
+    uint32_t seq;           /**< Task list insertions so far. */
+#endif
+#if QTASK_POOL_SIZE > 0
+    QTaskList *pool_free;   /**< Free slots, linked through their task_node.next. */
+    QTaskSlot pool[QTASK_POOL_SIZE]; /**< Static task pool. */
+#endif
 } QTaskSched;
 
 /**
@@ -97,6 +631,63 @@ void qtask_sched_init(QTaskSched *sched);
  */
 int qtask_add(QTaskSched *sched, QTaskObj* task, const char* name, QTaskHandle handle, size_t tick);
 
+/**
+ * @brief Adds a task whose execution function takes a context pointer.
+ * 
+ * Same as qtask_add, except that handle is called as handle(ctx) on every dispatch.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param task Pointer to the task object to be added.
+ * @param name Name of the task.
+ * @param handle Function pointer to the task's execution function.
+ * @param ctx Context pointer passed to handle.
+ * @param tick Periodic tick value for the task.
+ * @return 0 if the task is successfully added, 1 if the task already exists in the scheduled list.
+ */
+int qtask_add_ctx(QTaskSched *sched, QTaskObj* task, const char* name, QTaskHandleCtx handle, void *ctx, size_t tick);
+
+#if QTASK_POOL_SIZE > 0
+/**
+ * @brief Creates a task in a slot of the scheduler's static pool and adds it.
+ * 
+ * The name is copied into the slot, the task otherwise starts like one added with qtask_add.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param name Name of the task, shorter than QTASK_POOL_NAME_LEN.
+ * @param handle Function pointer to the task's execution function.
+ * @param tick Periodic tick value for the task.
+ * @return Pointer to the task object, QNULL if the pool is exhausted, the name is too long
+ *         or already registered.
+ */
+QTaskObj *qtask_create(QTaskSched *sched, const char *name, QTaskHandle handle, size_t tick);
+
+/**
+ * @brief Creates a pool task whose execution function takes a context pointer.
+ * 
+ * Same as qtask_create, except that handle is called as handle(ctx) on every dispatch.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param name Name of the task, shorter than QTASK_POOL_NAME_LEN.
+ * @param handle Function pointer to the task's execution function.
+ * @param ctx Context pointer passed to handle.
+ * @param tick Periodic tick value for the task.
+ * @return Pointer to the task object, QNULL on failure, see qtask_create.
+ */
+QTaskObj *qtask_create_ctx(QTaskSched *sched, const char *name, QTaskHandleCtx handle, void *ctx, size_t tick);
+
+/**
+ * @brief Removes a pool task from the scheduler and returns its slot to the pool.
+ * 
+ * Works whether the task is scheduled or suspended, and may be called from the task's own
+ * handler. The task pointer must not be used afterwards.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param task Task returned by qtask_create or qtask_create_ctx.
+ * @return 0 on success, -1 if the task is not a used slot of this scheduler's pool.
+ */
+int qtask_destroy(QTaskSched *sched, QTaskObj *task);
+#endif
+
 /**
  * @brief Removes a task from the task scheduler.
  * 
@@ -133,12 +724,78 @@ int qtask_resume(QTaskSched *sched, const char *name);
 /**
  * @brief Executes all ready tasks in the task scheduler.
  * 
- * This function iterates through the scheduled task list and executes all tasks marked as ready.
+ * This function drains the ready queues filled by qtask_tick_increase. Under QTASK_POLICY_PRIO
+ * the highest priority ready task runs next and tasks of equal priority run in release order,
+ * under QTASK_POLICY_EDF the ready task with the earliest absolute deadline runs next.
+ * Tasks that are not ready are never visited. With QTASK_USING_IDLE the idle hook is called first
+ * when nothing is ready, and the tasks released while it slept are executed.
  * 
  * @param sched Pointer to the task scheduler object.
  */
 void qtask_exec(QTaskSched *sched);
 
+/**
+ * @brief Executes the next ready task only.
+ * 
+ * Dequeues the task qtask_exec would run first and runs it for its pending activations, so the
+ * main loop can interleave other work between tasks. A replay follows a record with it.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @return The dequeued task, QNULL if nothing was ready.
+ */
+QTaskObj *qtask_exec_once(QTaskSched *sched);
+
+/**
+ * @brief Runs the ready tasks that go before the running one, from inside its handler.
+ * 
+ * Under QTASK_POLICY_PRIO these are the tasks of a strictly higher priority, under
+ * QTASK_POLICY_EDF the tasks with an earlier deadline. They run nested on the caller's stack,
+ * tasks released meanwhile are picked up as well, then the handler continues. The time spent in
+ * them is left out of the caller's rtime and, with QTASK_USING_BUDGET, its budget. Calling it at safe points of a long handler
+ * bounds the latency of urgent tasks to the distance between two calls.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @return Number of tasks dispatched, 0 outside a handler.
+ */
+int qtask_yield(QTaskSched *sched);
+
+/**
+ * @brief Checks whether any task is waiting to be executed.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @return Non-zero if the ready queue is not empty, 0 otherwise.
+ */
+int qtask_pending(QTaskSched *sched);
+
+/**
+ * @brief Arms a one-shot deferred call.
+ * 
+ * The task object runs handle(ctx) once, delay ticks from now, through the same ready queues
+ * as periodic tasks, then it is unlinked and can be armed again. Calling it again on an armed
+ * call restarts the delay, also from its own handler to make it periodic for a while. Arming and
+ * cancelling are O(1), the object needs no name and does not use the task index. With the list
+ * backend every armed call is counted down on each tick like a task, at most QTASK_TICK_SCAN_MAX
+ * calls can be armed at once, use the timing wheel for more.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param task Task object, not added with qtask_add, it may be uninitialized memory on first use.
+ * @param handle Function to call.
+ * @param ctx Context pointer passed to handle.
+ * @param delay Delay in ticks, 0 runs it on the next qtask_exec.
+ * @return 0 on success, -1 if the object is a task registered with this scheduler or the list
+ *         backend already has QTASK_TICK_SCAN_MAX calls armed.
+ */
+int qtask_defer(QTaskSched *sched, QTaskObj *task, QTaskHandleCtx handle, void *ctx, size_t delay);
+
+/**
+ * @brief Cancels a deferred call that has not run yet.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param task Task object armed with qtask_defer.
+ * @return 0 if the call was cancelled, -1 if it was not armed.
+ */
+int qtask_cancel(QTaskSched *sched, QTaskObj *task);
+
 /**
  * @brief Retrieves a task object by its name.
  * 
@@ -155,31 +812,325 @@ QTaskObj *qtask_obj(QTaskSched *sched, const char *taskname);
  * 
  * This function should be called periodically to update the timer values of all tasks.
  * When a task's timer reaches zero, it will be marked as ready for execution.
+ * With QTASK_USING_WHEEL enabled only the tasks expiring on this tick are visited.
  * 
  * @param sched Pointer to the task scheduler object.
  */
 void qtask_tick_increase(QTaskSched *sched);
 
+/**
+ * @brief Gets the number of ticks until the earliest task timer expires.
+ * 
+ * Used for tickless operation: program a one-shot timer with the returned value, sleep, then
+ * call qtask_tick_advance with the number of ticks that actually elapsed.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @return 0 if tasks are already waiting in the ready queue, QTASK_TICK_NONE if no timer is armed,
+ *         the number of ticks until the next release otherwise.
+ */
+size_t qtask_tick_next(QTaskSched *sched);
+
+/**
+ * @brief Advances all task timers by several ticks at once.
+ * 
+ * Equivalent to calling qtask_tick_increase n times: every task that expires inside the window is
+ * released and its timer keeps the same phase. Without the timing wheel this is a single pass over
+ * the scheduled task list.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param n Number of elapsed ticks.
+ */
+void qtask_tick_advance(QTaskSched *sched, size_t n);
+
 /**
  * @brief Measures the execution time of tasks.
  * 
  * This function should be called in a timer interrupt function with a higher frequency than
- * qtask_tick_increase to measure the execution time of task callback functions.
+ * qtask_tick_increase to measure the execution time of task callback functions. It charges the
+ * task whose handler is running, only needed when no clock is set with qtask_clock_set.
  * 
  * @param sched Pointer to the task scheduler object.
  */
 void qtask_runtime_increase(QTaskSched *sched);
 
+#if QTASK_USING_TRACE
+/**
+ * @brief Starts or stops recording scheduler events into the trace ring.
+ * 
+ * Recording is enabled by qtask_sched_init.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param enable Non-zero to record events.
+ */
+void qtask_trace_enable(QTaskSched *sched, uint8_t enable);
+
+/**
+ * @brief Writes the trace ring and the names of all registered tasks.
+ * 
+ * Stop recording first for a consistent snapshot. The output format is described with
+ * QTASK_TRACE_VERSION, tools/qtrace2json.c turns it into Chrome trace-event JSON for Perfetto.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param write Output function.
+ * @param arg Argument passed to the output function.
+ */
+void qtask_trace_dump(QTaskSched *sched, QTaskTraceWrite write, void *arg);
+#endif
+
+#if QTASK_USING_RECORD
+/**
+ * @brief Starts recording scheduler activity.
+ * 
+ * Writes the stream header, then every tick, add, del, suspend, resume, priority, policy, sleep
+ * and configuration change and every dispatch decision as a QTASK_REC_xxx event. Start right
+ * after qtask_sched_init, the replay rebuilds the task set from the recorded adds. The output
+ * function is called inside the critical section, from the tick interrupt too, so it should only
+ * copy into a buffer drained by the main loop. Calls that race the tick interrupt are ordered by
+ * their record, a replay reports the first dispatch that differs.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param write Output function.
+ * @param arg Argument passed to the output function.
+ * @return 0 on success, -1 if tasks are already registered.
+ */
+int qtask_record_start(QTaskSched *sched, QTaskTraceWrite write, void *arg);
+
+/**
+ * @brief Stops recording.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ */
+void qtask_record_stop(QTaskSched *sched);
+#endif
+
+/**
+ * @brief Sets the clock used to time task handlers.
+ * 
+ * qtask_exec reads the clock right before and after each handler and stores the difference in
+ * rtime. On Linux a CLOCK_MONOTONIC_RAW nanosecond clock is installed by qtask_sched_init.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param clock Clock function, QNULL to go back to qtask_runtime_increase.
+ */
+void qtask_clock_set(QTaskSched *sched, QTaskClock clock);
+
+#if QTASK_USING_IDLE
+/**
+ * @brief Sets the hook qtask_exec calls when no task is ready.
+ * 
+ * The Linux default installed by qtask_sched_init sleeps until the next release, or for one tick
+ * when no timer is armed, a signal such as a tick timer ends the sleep early. Tasks released from
+ * another thread during the sleep wait for it to end.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param hook Idle hook, QNULL to return from qtask_exec at once.
+ */
+void qtask_idle_set(QTaskSched *sched, QTaskIdleHook hook);
+#endif
+
+#if QTASK_USING_STATS
+/**
+ * @brief Copies the execution time statistics of a task.
+ * 
+ * @param task Pointer to the task object.
+ * @param stats Destination of the snapshot.
+ */
+void qtask_stats_get(QTaskObj *task, QTaskStats *stats);
+
+/**
+ * @brief Clears the execution time statistics of a task.
+ * 
+ * @param task Pointer to the task object.
+ */
+void qtask_stats_reset(QTaskObj *task);
+
+/**
+ * @brief Gets the sample variance of the run time from a statistics snapshot.
+ * 
+ * @param stats Pointer to the statistics.
+ * @return Variance in squared clock units, 0 with fewer than two runs.
+ */
+double qtask_stats_variance(const QTaskStats *stats);
+
+/**
+ * @brief Finds the scheduled task with the worst release to start latency.
+ * 
+ * Walks the scheduled task list, meant for diagnostics rather than the main loop.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @return Task with the largest latency_max, QNULL if no task has run yet.
+ */
+QTaskObj *qtask_latency_worst(QTaskSched *sched);
+#endif
+
+#if QTASK_USING_LOAD
+/**
+ * @brief Gets the CPU load over the most recent closed windows.
+ * 
+ * The load is handler time over wall time, the rest is time spent in the main loop with
+ * nothing ready plus scheduler overhead.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param windows Number of QTASK_LOAD_WINDOW tick windows to average, clamped to QTASK_LOAD_SLOTS.
+ * @return Load in permille.
+ */
+uint16_t qtask_load_get(QTaskSched *sched, size_t windows);
+
+/**
+ * @brief Gets the share of CPU time used by a task since the last qtask_load_reset.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param task Pointer to the task object.
+ * @return Share of wall time spent in the task handler, in permille.
+ */
+uint16_t qtask_load_task(QTaskSched *sched, QTaskObj *task);
+
+/**
+ * @brief Clears the load history and the per task CPU time of scheduled tasks.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ */
+void qtask_load_reset(QTaskSched *sched);
+#endif
+
 /**
  * @brief Changes the periodic time of a running task.
  * 
- * This function changes the timer value of the currently running task.
+ * This function changes the timer value of the currently running task. With
+ * QTASK_USING_ABSOLUTE a periodic task wakes up on the first release of its grid at least tick
+ * ticks away, the releases it sleeps through are not counted as missed.
  * 
  * @param sched Pointer to the task scheduler object.
  * @param tick New periodic tick value for the task.
  */
 void qtask_sleep(QTaskSched *sched, size_t tick);
 
+#if QTASK_USING_BUDGET
+/**
+ * @brief Gets the run time the running handler has left in its budget.
+ * 
+ * Lets a long computation split itself into chunks, it stops when the budget is spent and
+ * continues on its next activation. Time is in rtime units: clock units, or qtask_runtime_increase
+ * counts without a clock.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @return Budget left, 0 once it is spent, UINT32_MAX without a budget or outside a handler.
+ */
+uint32_t qtask_budget_remaining(QTaskSched *sched);
+
+/**
+ * @brief Tells the running handler whether it has spent its budget and should return.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @return 1 if the budget is spent, 0 otherwise.
+ */
+int qtask_should_yield(QTaskSched *sched);
+#endif
+
+/**
+ * @brief Sets the release phase of a periodic task.
+ * 
+ * The task is re-armed so that it is released on the ticks whose count modulo the period equals
+ * phase. Tasks added by qtask_add get the phase of the tick they were added on, so a task set
+ * added at once releases everything on the same ticks.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param task Pointer to the task object.
+ * @param phase Phase in ticks, below the task period.
+ * @return 0 on success, -1 if the task is not scheduled, not periodic or the phase is out of range.
+ */
+int qtask_phase_set(QTaskSched *sched, QTaskObj *task, size_t phase);
+
+/**
+ * @brief Chooses the phase of a task that flattens the per tick load, and applies it.
+ * 
+ * Looks QTASK_PHASE_HORIZON ticks ahead at the releases of the other armed tasks and picks the
+ * phase whose worst tick carries the least releases or handler time, ties go to the least total.
+ * Call it for each task after adding them, with QTASK_PHASE_LOAD preferably after the handlers
+ * have run for a while, tasks that never ran weigh one clock unit.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param task Pointer to the task object.
+ * @param mode QTASK_PHASE_COUNT or QTASK_PHASE_LOAD.
+ * @return The phase applied, QTASK_TICK_NONE if the task is not scheduled or not periodic.
+ */
+size_t qtask_phase_auto(QTaskSched *sched, QTaskObj *task, uint8_t mode);
+
+/**
+ * @brief Changes the dispatch priority of a task.
+ * 
+ * A task already waiting in the ready queue is moved to the queue of its new priority.
+ * Tasks added by qtask_add start with priority 0.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param task Pointer to the task object.
+ * @param prio New priority, 0 is the lowest and QTASK_PRIO_NUM - 1 the highest.
+ * @return 0 on success, -1 if the priority is out of range.
+ */
+int qtask_prio_set(QTaskSched *sched, QTaskObj *task, uint8_t prio);
+
+/**
+ * @brief Selects the dispatch policy of a scheduler.
+ * 
+ * @param sched Pointer to the task scheduler object.
+ * @param policy QTASK_POLICY_PRIO, or QTASK_POLICY_EDF when QTASK_USING_EDF is enabled.
+ * @return 0 on success, -1 if the policy is not available.
+ */
+int qtask_policy_set(QTaskSched *sched, uint8_t policy);
+
+#if QTASK_USING_OVERRUN
+/**
+ * @brief Selects what qtask_exec does with activations that piled up while a task was waiting.
+ * 
+ * Dropped activations are counted in QTaskObj::missed. Tasks added by qtask_add use
+ * QTASK_OVERRUN_ONCE, the historical behaviour.
+ * 
+ * @param task Pointer to the task object.
+ * @param policy QTASK_OVERRUN_ONCE, QTASK_OVERRUN_SKIP or QTASK_OVERRUN_CATCHUP.
+ * @param catchup Maximum number of back to back runs for QTASK_OVERRUN_CATCHUP, ignored otherwise.
+ * @return 0 on success, -1 if the policy is invalid.
+ */
+int qtask_overrun_set(QTaskObj *task, uint8_t policy, uint16_t catchup);
+#endif
+
+#if QTASK_USING_EDF || QTASK_USING_DEADLINE
+/**
+ * @brief Sets the relative deadline of a task.
+ * 
+ * Each activation gets an absolute deadline of release tick + deadline, a deadline of 0 (the
+ * default) uses the task period. Takes effect from the next release. With QTASK_USING_DEADLINE
+ * and a non-zero deadline qtask_exec checks the tick count when the handler starts and when it
+ * returns, counts misses in QTaskObj::dmiss and calls the miss hook.
+ * 
+ * @param task Pointer to the task object.
+ * @param tick Relative deadline in ticks.
+ */
+void qtask_deadline_set(QTaskObj *task, size_t tick);
+#endif
+
+#if QTASK_USING_DEADLINE
+/**
+ * @brief Sets the callback invoked when a task misses its deadline.
+ * 
+ * @param task Pointer to the task object.
+ * @param hook Callback, QNULL to only count misses.
+ */
+void qtask_miss_hook_set(QTaskObj *task, QTaskMissHook hook);
+#endif
+
+#if QTASK_USING_BUDGET
+/**
+ * @brief Sets the cooperative run time budget of a task.
+ * 
+ * The scheduler never interrupts a handler, the budget is only reported to it through
+ * qtask_budget_remaining and qtask_should_yield.
+ * 
+ * @param task Pointer to the task object.
+ * @param budget Run time per run in rtime units, 0 for no budget.
+ */
+void qtask_budget_set(QTaskObj *task, uint32_t budget);
+#endif
+
 /**
  * @brief Changes the periodic time of a task.
  * 
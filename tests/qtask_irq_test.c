@@ -0,0 +1,106 @@
+/*
+ * Tick interrupt test, every critical section exit may deliver a pending tick the way a real
+ * interrupt would once it is unmasked. Build qtask.c with the same hooks:
+ *   cc -O2 -I.. -include qtask_irq_test.h -D'QTASK_CRITICAL_ENTER()=test_enter()' \
+ *      -D'QTASK_CRITICAL_EXIT()=test_exit()' -o test_irq qtask_irq_test.c ../qtask.c
+ *
+ * The tick is delivered at the first, second, ... exit inside each call, so every gap between
+ * two critical sections of a call is hit once. Exits with 1 on the first failed check.
+ */
+
+#include <stdio.h>
+#include "qtask.h"
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if(!(cond)) {                                                           \
+            fprintf(stderr, "%s:%d: check failed at exit %d: %s\n", __FILE__, __LINE__, at, #cond); \
+            return -1;                                                          \
+        }                                                                       \
+    } while(0)
+
+static QTaskSched sched;
+static QTaskObj x, y, call;
+static int depth, countdown, in_irq, at;
+static uint32_t runs[3];
+
+void test_enter(void)
+{
+    depth++;
+}
+
+void test_exit(void)
+{
+    if(--depth == 0 && countdown > 0 && --countdown == 0 && !in_irq) {
+        in_irq = 1;
+        qtask_tick_increase(&sched);
+        in_irq = 0;
+    }
+}
+
+static void _count(void *ctx)
+{
+    (*(uint32_t *)ctx)++;
+}
+
+static void _step(void)
+{
+    runs[0] = runs[1] = runs[2] = 0;
+    qtask_tick_increase(&sched);
+    qtask_exec(&sched);
+}
+
+static int _test(void)
+{
+    uint32_t total;
+
+    qtask_sched_init(&sched);
+    CHECK(qtask_add_ctx(&sched, &x, "x", _count, &runs[0], 1) == 0);
+    CHECK(qtask_add_ctx(&sched, &y, "y", _count, &runs[1], 1) == 0);
+    CHECK(qtask_defer(&sched, &call, _count, &runs[2], 1) == 0);
+    _step();
+
+    // A tick inside suspend or del must not queue the task again
+    countdown = at;
+    CHECK(qtask_suspend(&sched, "x") == 0);
+    countdown = at;
+    CHECK(qtask_del(&sched, &y) == 0);
+    countdown = 0;
+    CHECK(x.ready_node.next == &x.ready_node && y.ready_node.next == &y.ready_node);
+    _step();
+    CHECK(runs[0] == 0 && runs[1] == 0);
+
+    // A restart drops the old expiry even when it lands during the restart, a tick right after the
+    // restart counts towards the new delay
+    CHECK(qtask_defer(&sched, &call, _count, &runs[2], 1) == 0);
+    countdown = at;
+    CHECK(qtask_defer(&sched, &call, _count, &runs[2], 3) == 0);
+    countdown = 0;
+    _step();
+    CHECK(runs[2] == 0);
+    total = 0;
+    for(int i = 0; i < 3; i++) {
+        _step();
+        total += runs[2];
+    }
+    CHECK(total == 1);
+
+    // And a cancel drops it as well
+    CHECK(qtask_defer(&sched, &call, _count, &runs[2], 1) == 0);
+    countdown = at;
+    CHECK(qtask_cancel(&sched, &call) == 0);
+    countdown = 0;
+    CHECK(call.ready_node.next == &call.ready_node);
+    return 0;
+}
+
+int main(void)
+{
+    for(at = 1; at <= 8; at++) {
+        if(_test() != 0) {
+            return 1;
+        }
+    }
+    printf("irq ok\n");
+    return 0;
+}
@@ -0,0 +1,11 @@
+/*
+ * Critical section hooks of qtask_irq_test.c, included ahead of qtask.c and the test.
+ */
+
+#ifndef _QTASK_IRQ_TEST_H
+#define _QTASK_IRQ_TEST_H
+
+void test_enter(void);
+void test_exit(void);
+
+#endif
@@ -0,0 +1,190 @@
+/*
+ * Record and replay round trip, drives a random task set through every recorded call and writes
+ * the stream for tools/qtask_replay.c, built with the same options:
+ *   cc -O2 -I.. -DQTASK_USING_RECORD=1 -o test_record qtask_record_test.c ../qtask.c
+ *   cc -O2 -I.. -DQTASK_USING_RECORD=1 -o qtask_replay ../tools/qtask_replay.c ../qtask.c
+ *   ./test_record rec.bin && ./qtask_replay rec.bin
+ *
+ * Handlers tick the scheduler the way an interrupt would, re-arm, cancel and suspend other tasks,
+ * change their own period and that of armed calls, sleep and yield, so the replay has to reproduce
+ * calls made from inside a handler and dispatches nested in one. The clock is left out and the
+ * sequence is seeded, every run makes the same calls. Deadlines, overrun policies and EDF are
+ * exercised when built in. The replay exits with 2 on the first dispatch that differs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "qtask.h"
+
+#if !QTASK_USING_RECORD
+#error "build the test with -DQTASK_USING_RECORD=1"
+#endif
+
+#define TASK_NUM        24
+#define DEFER_NUM       24
+#define STEP_NUM        100000
+
+static QTaskSched sched;
+static QTaskObj tasks[TASK_NUM];
+static QTaskObj calls[DEFER_NUM];
+static char names[TASK_NUM][16];
+static uint32_t seed = 1;
+static uint64_t runs;
+
+static uint32_t _rand(void)
+{
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 16) & 0x7fff;
+}
+
+static void _write(const void *data, size_t len, void *arg)
+{
+    fwrite(data, 1, len, (FILE *)arg);
+}
+
+static void _handle(void *ctx)
+{
+    QTaskObj *self = ctx;
+
+    runs++;
+    switch(_rand() % 12) {
+    case 0:
+        qtask_tick_increase(&sched);
+        break;
+    case 1:
+        qtask_tick_set(self, 1 + _rand() % 9);
+        qtask_tick_set(&calls[_rand() % DEFER_NUM], _rand() % 9);
+        break;
+    case 2:
+        qtask_suspend(&sched, names[_rand() % TASK_NUM]);
+        break;
+    case 3:
+        qtask_defer(&sched, &calls[_rand() % DEFER_NUM], _handle, &calls[_rand() % DEFER_NUM], _rand() % 4);
+        break;
+    case 4:
+        qtask_cancel(&sched, &calls[_rand() % DEFER_NUM]);
+        break;
+    case 5:
+        qtask_tick_increase(&sched);
+        qtask_yield(&sched);
+        break;
+    case 6:
+        qtask_yield(&sched);
+        break;
+    case 7:
+        qtask_sleep(&sched, 1 + _rand() % 7);
+        break;
+    default:
+        break;
+    }
+}
+
+static void _step(void)
+{
+    size_t i = _rand() % TASK_NUM;
+    QTaskObj *task = &tasks[i];
+    uint32_t op = _rand() % 40;
+
+    switch(op) {
+    case 0:
+        qtask_add_ctx(&sched, task, names[i], _handle, task, 1 + _rand() % 20);
+        break;
+    case 1:
+        qtask_del(&sched, task);
+        break;
+    case 2:
+        qtask_suspend(&sched, names[i]);
+        break;
+    case 3:
+        qtask_resume(&sched, names[i]);
+        break;
+    case 4:
+        if(task->state != QTASK_STATE_NONE) {
+            qtask_prio_set(&sched, task, (uint8_t)(_rand() % QTASK_PRIO_NUM));
+        }
+        break;
+    case 5:
+#if QTASK_USING_OVERRUN
+        qtask_overrun_set(task, (uint8_t)(_rand() % 3), (uint16_t)(1 + _rand() % 3));
+#endif
+        break;
+    case 6:
+#if QTASK_USING_EDF || QTASK_USING_DEADLINE
+        qtask_deadline_set(task, _rand() % 10);
+#endif
+        break;
+    case 7:
+        qtask_tick_set(task, 1 + _rand() % 15);
+        break;
+    case 8:
+        qtask_tick_advance(&sched, _rand() % 5);
+        break;
+    case 9:
+        if(task->period) {
+            qtask_phase_set(&sched, task, _rand() % task->period);
+        }
+        break;
+    case 10:
+        qtask_phase_auto(&sched, task, (uint8_t)(_rand() % 2));
+        break;
+    case 11:
+    case 12:
+        qtask_defer(&sched, &calls[i], _handle, &calls[i], _rand() % 9);
+        break;
+    case 13:
+        qtask_cancel(&sched, &calls[i]);
+        break;
+    case 14:
+    case 15:
+        qtask_exec_once(&sched);
+        break;
+    default:
+        if(op < 30) {
+            qtask_tick_increase(&sched);
+        } else {
+            qtask_exec(&sched);
+        }
+        break;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    FILE *fp;
+
+    if(argc != 2) {
+        fprintf(stderr, "usage: %s <record.bin>\n", argv[0]);
+        return 1;
+    }
+    fp = fopen(argv[1], "wb");
+    if(!fp) {
+        perror(argv[1]);
+        return 1;
+    }
+    for(int i = 0; i < TASK_NUM; i++) {
+        snprintf(names[i], sizeof(names[i]), "task%d", i);
+    }
+
+    qtask_sched_init(&sched);
+    qtask_clock_set(&sched, QNULL);
+#if QTASK_USING_IDLE
+    qtask_idle_set(&sched, QNULL);
+#endif
+    if(qtask_record_start(&sched, _write, fp) != 0) {
+        fprintf(stderr, "record start failed\n");
+        return 1;
+    }
+#if QTASK_USING_EDF
+    qtask_policy_set(&sched, QTASK_POLICY_EDF);
+#endif
+    for(int i = 0; i < STEP_NUM; i++) {
+        _step();
+    }
+    qtask_record_stop(&sched);
+    if(fclose(fp) != 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    printf("recorded %llu ticks, %llu runs\n", (unsigned long long)sched.tick, (unsigned long long)runs);
+    return 0;
+}
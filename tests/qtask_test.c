@@ -0,0 +1,521 @@
+/*
+ * Host regression test of the scheduler core, build it once per backend and compare the output:
+ *   cc -O2 -I.. -DQTASK_HASH_SIZE=64 -DQTASK_POOL_SIZE=8 -DQTASK_USING_DEADLINE=1 -DQTASK_USING_OVERRUN=1 -DQTASK_USING_WHEEL=0 -o test_list qtask_test.c ../qtask.c
+ *   cc -O2 -I.. -DQTASK_HASH_SIZE=64 -DQTASK_POOL_SIZE=8 -DQTASK_USING_DEADLINE=1 -DQTASK_USING_OVERRUN=1 -DQTASK_USING_WHEEL=1 -o test_wheel qtask_test.c ../qtask.c
+ *   ./test_list > list.txt && ./test_wheel > wheel.txt && cmp list.txt wheel.txt
+ *
+ * Releases of periodic tasks and one-shot calls are checked tick by tick against a model that
+ * knows nothing of the backend, dispatch order included: tasks of equal priority released on the
+ * same tick run in task list order, periodic tasks newest insertion first, then one-shot calls
+ * newest first. The summary line is a hash of the dispatch sequence, so both builds print the
+ * same output. Lookups by name are checked with names whose ids collide, with the task index
+ * roomy and after it has filled up. A deadline set while an activation is pending must not count
+ * a miss against it. One-shot calls are restarted and cancelled from handlers, their own and
+ * ones already released, and handlers yield to higher priorities with one yield nested in
+ * another. With a pool, tasks destroy themselves and hand their slot to the next task from their
+ * own handler. Exits with 1 on the first failed check.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "qtask.h"
+
+#define TASK_NUM        64
+#define DEFER_NUM       16
+#define TICK_NUM        5000
+#define FILL_NUM        (QTASK_HASH_SIZE + 16)
+#define NEVER           UINT64_MAX
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if(!(cond)) {                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return -1;                                                          \
+        }                                                                       \
+    } while(0)
+
+static QTaskSched sched;
+static QTaskObj tasks[TASK_NUM + DEFER_NUM];
+static char names[TASK_NUM][16];
+static size_t order[TASK_NUM + DEFER_NUM];
+static size_t order_num;
+static uint32_t seed = 1;
+
+static uint32_t _rand(void)
+{
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 16) & 0x7fff;
+}
+
+static void _handle(void *ctx)
+{
+    size_t i = (size_t)((QTaskObj *)ctx - tasks);
+
+    if(order_num < TASK_NUM + DEFER_NUM) {
+        order[order_num++] = i;
+    }
+}
+
+static void _count(void *ctx)
+{
+    (*(uint32_t *)ctx)++;
+}
+
+static void _nop(void)
+{
+}
+
+// Model of the task list order, later insertions run first and one-shot calls after periodic tasks
+static int _before(size_t a, size_t b, const uint32_t *pos)
+{
+    if((a >= TASK_NUM) != (b >= TASK_NUM)) {
+        return b >= TASK_NUM;
+    }
+    return pos[a] > pos[b];
+}
+
+// Releases of every tick must be exactly the ones the model expects, whatever the backend
+static int _test_release(void)
+{
+    static uint64_t next[TASK_NUM + DEFER_NUM], grid[TASK_NUM];
+    static uint32_t pos[TASK_NUM + DEFER_NUM];
+    static size_t period[TASK_NUM];
+    size_t expect[TASK_NUM + DEFER_NUM];
+    size_t expect_num, j;
+    uint64_t hash = 14695981039346656037ull, releases = 0;
+    uint64_t tick;
+    uint32_t insert = 0;
+
+    qtask_sched_init(&sched);
+    for(size_t i = 0; i < TASK_NUM + DEFER_NUM; i++) {
+        next[i] = NEVER;
+    }
+    for(tick = 1; tick <= TICK_NUM; tick++) {
+        // Staggered adds, periods spread over several wheel levels
+        if(tick <= TASK_NUM) {
+            size_t i = (size_t)tick - 1;
+            period[i] = 1 + _rand() % ((i & 1) ? 7 : 700);
+            sprintf(names[i], "task%zu", i);
+            CHECK(qtask_add_ctx(&sched, &tasks[i], names[i], _handle, &tasks[i], period[i]) == 0);
+            next[i] = sched.tick + period[i];
+            pos[i] = ++insert;
+        }
+        if(tick % 10 == 0) {
+            size_t i = TASK_NUM + _rand() % DEFER_NUM;
+            size_t delay = 1 + _rand() % 300;
+            CHECK(qtask_defer(&sched, &tasks[i], _handle, &tasks[i], delay) == 0);
+            // A restart keeps the place of the armed call
+            if(next[i] == NEVER) {
+                pos[i] = ++insert;
+            }
+            next[i] = sched.tick + delay;
+        }
+        if(tick == 1000) {
+            for(size_t i = 0; i < TASK_NUM; i += 7) {
+                CHECK(qtask_suspend(&sched, names[i]) == 0);
+                grid[i] = next[i];
+                next[i] = NEVER;
+            }
+        }
+        if(tick == 1500) {
+            for(size_t i = 0; i < TASK_NUM; i += 7) {
+                CHECK(qtask_resume(&sched, names[i]) == 0);
+                pos[i] = ++insert;
+#if QTASK_USING_ABSOLUTE
+                // Back on the release grid it had before the suspend
+                for(next[i] = grid[i]; next[i] <= sched.tick; next[i] += period[i]) {
+                }
+#else
+                (void)grid;
+                next[i] = sched.tick + period[i];
+#endif
+            }
+        }
+        if(tick == 2500) {
+            for(size_t i = 3; i < TASK_NUM; i += 5) {
+                CHECK(qtask_del(&sched, &tasks[i]) == 0);
+                next[i] = NEVER;
+            }
+        }
+
+        order_num = 0;
+        qtask_tick_increase(&sched);
+        qtask_exec(&sched);
+
+        // Insertion sort of the tasks due on this tick into task list order
+        expect_num = 0;
+        for(size_t i = 0; i < TASK_NUM + DEFER_NUM; i++) {
+            if(next[i] != sched.tick) {
+                continue;
+            }
+            for(j = expect_num++; j > 0 && _before(i, expect[j - 1], pos); j--) {
+                expect[j] = expect[j - 1];
+            }
+            expect[j] = i;
+            next[i] = (i < TASK_NUM) ? next[i] + period[i] : NEVER;
+        }
+        if(order_num != expect_num || memcmp(order, expect, expect_num * sizeof(size_t)) != 0) {
+            fprintf(stderr, "tick %llu: dispatched", (unsigned long long)sched.tick);
+            for(j = 0; j < order_num; j++) {
+                fprintf(stderr, " %zu", order[j]);
+            }
+            fprintf(stderr, ", expected");
+            for(j = 0; j < expect_num; j++) {
+                fprintf(stderr, " %zu", expect[j]);
+            }
+            fprintf(stderr, "\n");
+            return -1;
+        }
+        for(j = 0; j < order_num; j++) {
+            hash = (hash ^ (sched.tick * (TASK_NUM + DEFER_NUM) + order[j])) * 1099511628211ull;
+        }
+        releases += order_num;
+    }
+    printf("releases %llu hash %016llx\n", (unsigned long long)releases, (unsigned long long)hash);
+    return 0;
+}
+
+// Both names hash to the same id, every lookup must still resolve to its own task
+static int _test_collide(const char *stage)
+{
+    static QTaskObj pair[2];
+    static uint32_t count[2];
+    QTaskObj *a = &pair[0], *b = &pair[1];
+
+    CHECK(qtask_add_ctx(&sched, a, "0z", _count, &count[0], 1) == 0);
+    CHECK(qtask_add_ctx(&sched, b, "1Y", _count, &count[1], 1) == 0);
+    CHECK(a->id == b->id);
+#if QTASK_USING_TRACE
+    CHECK(a->trace_key != b->trace_key);
+#endif
+    CHECK(qtask_obj(&sched, "0z") == a);
+    CHECK(qtask_obj(&sched, "1Y") == b);
+
+    CHECK(qtask_suspend(&sched, "0z") == 0);
+    CHECK(qtask_obj(&sched, "0z") == QNULL);
+    CHECK(qtask_obj(&sched, "1Y") == b);
+    CHECK(qtask_suspend(&sched, "0z") == -1);
+    memset(count, 0, sizeof(count));
+    qtask_tick_increase(&sched);
+    qtask_exec(&sched);
+    CHECK(count[0] == 0 && count[1] == 1);
+
+    CHECK(qtask_resume(&sched, "0z") == 0);
+    CHECK(qtask_resume(&sched, "1Y") == -1);
+    CHECK(qtask_obj(&sched, "0z") == a);
+    memset(count, 0, sizeof(count));
+    qtask_tick_increase(&sched);
+    qtask_exec(&sched);
+    CHECK(count[0] == 1 && count[1] == 1);
+
+    CHECK(qtask_del(&sched, b) == 0);
+    CHECK(qtask_obj(&sched, "1Y") == QNULL);
+    CHECK(qtask_obj(&sched, "0z") == a);
+    CHECK(qtask_resume(&sched, "1Y") == 0);
+    CHECK(qtask_obj(&sched, "1Y") == b);
+    CHECK(qtask_del(&sched, a) == 0);
+    CHECK(qtask_del(&sched, b) == 0);
+    printf("collide %s ok\n", stage);
+    return 0;
+}
+
+static void _ticks(size_t n)
+{
+    while(n--) {
+        qtask_tick_increase(&sched);
+    }
+}
+
+// One tick at a time, each followed by the main loop pass
+static void _steps(size_t n)
+{
+    while(n--) {
+        qtask_tick_increase(&sched);
+        qtask_exec(&sched);
+    }
+}
+
+static QTaskObj call_a, call_b;
+static uint32_t call_runs[2];
+static int call_case;
+
+static void _call_a(void *ctx)
+{
+    (void)ctx;
+    call_runs[0]++;
+    switch(call_case) {
+    case 0:
+        if(call_runs[0] == 1) {
+            qtask_defer(&sched, &call_a, _call_a, QNULL, 2);
+        }
+        break;
+    case 1:
+        qtask_defer(&sched, &call_a, _call_a, QNULL, 2);
+        qtask_cancel(&sched, &call_a);
+        break;
+    case 2:
+        qtask_defer(&sched, &call_b, _count, &call_runs[1], 3);
+        break;
+    case 3:
+        qtask_cancel(&sched, &call_b);
+        break;
+    default:
+        if(call_runs[0] == 1) {
+            qtask_defer(&sched, &call_a, _call_a, QNULL, 0);
+        }
+        break;
+    }
+}
+
+// Arm b, then a, so that a runs first when both expire on the same tick
+static void _call_arm(int which)
+{
+    call_case = which;
+    call_runs[0] = call_runs[1] = 0;
+    qtask_defer(&sched, &call_b, _count, &call_runs[1], 1);
+    qtask_defer(&sched, &call_a, _call_a, QNULL, 1);
+}
+
+// One-shot calls restarted and cancelled from a handler, their own or one already released
+static int _test_defer(void)
+{
+    qtask_sched_init(&sched);
+
+    // Re-armed by its own handler, it runs again after the new delay only
+    _call_arm(0);
+    _steps(1);
+    CHECK(call_runs[0] == 1 && call_a.state == QTASK_STATE_ONESHOT);
+    _steps(1);
+    CHECK(call_runs[0] == 1);
+    _steps(1);
+    CHECK(call_runs[0] == 2 && call_a.state == QTASK_STATE_NONE);
+
+    // Restarted and cancelled by its own handler, it is done
+    _call_arm(1);
+    _steps(5);
+    CHECK(call_runs[0] == 1 && call_a.state == QTASK_STATE_NONE);
+    CHECK(qtask_cancel(&sched, &call_a) == -1);
+
+    // A released call restarted by another handler drops that expiry and waits for the new delay
+    _call_arm(2);
+    _steps(1);
+    CHECK(call_runs[0] == 1 && call_runs[1] == 0);
+    _steps(2);
+    CHECK(call_runs[1] == 0);
+    _steps(1);
+    CHECK(call_runs[1] == 1 && call_b.state == QTASK_STATE_NONE);
+
+    // And a released call cancelled by another handler never runs
+    _call_arm(3);
+    _steps(10);
+    CHECK(call_runs[0] == 1 && call_runs[1] == 0 && call_b.state == QTASK_STATE_NONE);
+
+    // Re-armed without delay, it runs again in the same pass
+    _call_arm(4);
+    qtask_tick_increase(&sched);
+    qtask_exec(&sched);
+    CHECK(call_runs[0] == 2 && call_runs[1] == 1);
+    CHECK(sched.defer_num == 0);
+    printf("defer ok\n");
+    return 0;
+}
+
+static QTaskObj yield_lo, yield_eq, yield_mid, yield_hi;
+static char yield_log[8];
+static size_t yield_len;
+static int yield_ret[2], yield_self;
+static uint32_t now;
+
+static uint32_t _clock(void)
+{
+    return now;
+}
+
+// lo releases mid and eq and yields, mid releases hi and yields again from the nested run
+static void _yield_task(void *ctx)
+{
+    QTaskObj *self = ctx;
+
+    yield_self += (sched.run_task == self);
+    if(yield_len < sizeof(yield_log) - 1) {
+        yield_log[yield_len++] = self->name[0];
+    }
+    if(self == &yield_lo) {
+        now += 10;
+        qtask_tick_increase(&sched);
+        yield_ret[0] = qtask_yield(&sched);
+    } else if(self == &yield_mid) {
+        now += 50;
+        qtask_tick_increase(&sched);
+        yield_ret[1] = qtask_yield(&sched);
+    } else {
+        now += 100;
+    }
+    yield_self += (sched.run_task == self);
+}
+
+// Nested dispatch only runs higher priorities, nests again and leaves the callers their own rtime
+static int _test_yield(void)
+{
+    qtask_sched_init(&sched);
+    qtask_clock_set(&sched, _clock);
+    CHECK(qtask_yield(&sched) == 0);
+    CHECK(qtask_add_ctx(&sched, &yield_lo, "lo", _yield_task, &yield_lo, 10) == 0);
+    CHECK(qtask_add_ctx(&sched, &yield_eq, "eq", _yield_task, &yield_eq, 10) == 0);
+    CHECK(qtask_add_ctx(&sched, &yield_mid, "mid", _yield_task, &yield_mid, 10) == 0);
+    CHECK(qtask_add_ctx(&sched, &yield_hi, "hi", _yield_task, &yield_hi, 10) == 0);
+    CHECK(qtask_prio_set(&sched, &yield_lo, 1) == 0);
+    CHECK(qtask_prio_set(&sched, &yield_eq, 1) == 0);
+    CHECK(qtask_prio_set(&sched, &yield_mid, 2) == 0);
+    CHECK(qtask_prio_set(&sched, &yield_hi, 3) == 0);
+    CHECK(qtask_phase_set(&sched, &yield_lo, 5) == 0);
+    CHECK(qtask_phase_set(&sched, &yield_eq, 6) == 0);
+    CHECK(qtask_phase_set(&sched, &yield_mid, 6) == 0);
+    CHECK(qtask_phase_set(&sched, &yield_hi, 7) == 0);
+    _ticks(5);
+    qtask_exec(&sched);
+    CHECK(strcmp(yield_log, "lmhe") == 0);
+    CHECK(yield_ret[0] == 1 && yield_ret[1] == 1);
+    CHECK(yield_self == 8 && sched.run_task == QNULL);
+    CHECK(yield_lo.rtime == 10 && yield_mid.rtime == 50 && yield_hi.rtime == 100);
+    printf("yield ok\n");
+    return 0;
+}
+
+#if QTASK_USING_DEADLINE
+// A deadline set while an activation is pending only applies from the next release
+static int _test_deadline(void)
+{
+    static QTaskObj task;
+    static uint32_t count;
+
+    qtask_sched_init(&sched);
+    CHECK(qtask_add_ctx(&sched, &task, "dl", _count, &count, 10) == 0);
+    _ticks(10);
+    qtask_deadline_set(&task, 3);
+    qtask_exec(&sched);
+    CHECK(count == 1 && task.dmiss == 0);
+    _ticks(14);
+    qtask_exec(&sched);
+    CHECK(count == 2 && task.dmiss == 1);
+    _ticks(5);
+    qtask_deadline_set(&task, 0);
+    _ticks(6);
+    qtask_exec(&sched);
+    CHECK(count == 3 && task.dmiss == 1);
+    CHECK(qtask_del(&sched, &task) == 0);
+    printf("deadline ok\n");
+    return 0;
+}
+#endif
+
+#if QTASK_POOL_SIZE > 0
+static QTaskObj *conn;
+static uint32_t conn_runs[2];
+
+static void _conn2(void)
+{
+    conn_runs[1]++;
+}
+
+// Per connection pattern, the next task gets the slot the running one just gave back
+static void _conn1(void)
+{
+    conn_runs[0]++;
+    qtask_destroy(&sched, conn);
+    conn = qtask_create(&sched, "conn2", _conn2, 5);
+#if QTASK_USING_OVERRUN
+    qtask_overrun_set(conn, QTASK_OVERRUN_CATCHUP, 4);
+#endif
+}
+
+static int _test_pool(void)
+{
+    QTaskObj *slots[QTASK_POOL_SIZE];
+    QTaskObj *first;
+    char name[16];
+
+    qtask_sched_init(&sched);
+    conn = first = qtask_create(&sched, "conn1", _conn1, 1);
+    CHECK(conn != QNULL);
+#if QTASK_USING_OVERRUN
+    CHECK(qtask_overrun_set(conn, QTASK_OVERRUN_CATCHUP, 4) == 0);
+#endif
+    qtask_tick_advance(&sched, 3);
+    qtask_exec(&sched);
+    // Only one of the three catch-up runs, and none of them went to the new task
+    CHECK(conn_runs[0] == 1 && conn_runs[1] == 0);
+    CHECK(conn == first);
+    for(int i = 0; i < 5; i++) {
+        qtask_tick_increase(&sched);
+        qtask_exec(&sched);
+    }
+    CHECK(conn_runs[1] == 1);
+    CHECK(qtask_destroy(&sched, conn) == 0);
+    CHECK(qtask_destroy(&sched, conn) == -1);
+    CHECK(qtask_destroy(&sched, &tasks[0]) == -1);
+
+    // Every slot once, then the pool is exhausted until one comes back
+    for(int i = 0; i < QTASK_POOL_SIZE; i++) {
+        sprintf(name, "slot%d", i);
+        slots[i] = qtask_create(&sched, name, _nop, 1);
+        CHECK(slots[i] != QNULL);
+        CHECK(qtask_obj(&sched, name) == slots[i]);
+    }
+    CHECK(qtask_create(&sched, "more", _nop, 1) == QNULL);
+    CHECK(qtask_create(&sched, "slot0", _nop, 1) == QNULL);
+    CHECK(qtask_destroy(&sched, slots[3]) == 0);
+    CHECK(qtask_obj(&sched, "slot3") == QNULL);
+    CHECK(qtask_create(&sched, "more", _nop, 1) == slots[3]);
+    for(int i = 0; i < 3; i++) {
+        qtask_tick_increase(&sched);
+        qtask_exec(&sched);
+    }
+    for(int i = 0; i < QTASK_POOL_SIZE; i++) {
+        CHECK(qtask_destroy(&sched, slots[i]) == 0);
+    }
+    printf("pool ok\n");
+    return 0;
+}
+#endif
+
+int main(void)
+{
+    static QTaskObj fill[FILL_NUM];
+    static char fill_names[FILL_NUM][16];
+
+    if(_test_release() != 0) {
+        return 1;
+    }
+
+    qtask_sched_init(&sched);
+    if(_test_collide("index") != 0) {
+        return 1;
+    }
+    // Fill the index so that the colliding names are only found by walking the task lists
+    for(size_t i = 0; i < FILL_NUM; i++) {
+        sprintf(fill_names[i], "fill%zu", i);
+        if(qtask_add(&sched, &fill[i], fill_names[i], _nop, 1000) != 0) {
+            fprintf(stderr, "cannot add %s\n", fill_names[i]);
+            return 1;
+        }
+    }
+    if(_test_collide("full index") != 0) {
+        return 1;
+    }
+    if(_test_defer() != 0 || _test_yield() != 0) {
+        return 1;
+    }
+#if QTASK_USING_DEADLINE
+    if(_test_deadline() != 0) {
+        return 1;
+    }
+#endif
+#if QTASK_POOL_SIZE > 0
+    if(_test_pool() != 0) {
+        return 1;
+    }
+#endif
+    return 0;
+}
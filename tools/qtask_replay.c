@@ -0,0 +1,450 @@
+/*
+ * Replays a stream written by qtask_record_start against a scheduler built from the same qtask.c,
+ * so a field interleaving can be stepped through in a debugger or profiled under perf.
+ *
+ * Every recorded task is re-created with a stub handler that replays the events recorded while
+ * the real handler was running, ticks from the interrupt included. Each recorded dispatch is
+ * reproduced with qtask_exec_once and checked, the first dispatch that differs is reported.
+ * Dispatches nested by qtask_yield are replayed the same way from inside the stub handler.
+ * Build with the options of the recording target (backend, priorities, EDF, scan bound):
+ *   cc -O2 -g -I.. -DQTASK_USING_RECORD=1 -o qtask_replay qtask_replay.c ../qtask.c
+ * Usage: qtask_replay [-v] [-r repeat] <record.bin>
+ *   -v  print every dispatch as "tick name"
+ *   -r  replay the stream repeat times, e.g. to collect enough perf samples
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "qtask.h"
+
+#if !QTASK_USING_RECORD
+#error "build the replay with -DQTASK_USING_RECORD=1"
+#endif
+
+#define HEADER_LEN      27
+
+typedef struct {
+    QTaskObj obj;
+    uint64_t key;           /* Address of the recorded object. */
+    char *name;
+} ReplayTask;
+
+typedef struct {
+    uint8_t type;
+    uint64_t key;
+    uint64_t arg;           /* Ticks, priority, policy or period. */
+    uint64_t deadline;
+    uint8_t overrun;
+    uint64_t catchup;
+    const uint8_t *name;
+    uint8_t name_len;
+} ReplayEvt;
+
+static QTaskSched sched;
+static ReplayTask **tasks;
+static size_t task_num;
+static size_t task_cap;
+static uint8_t *data;
+static size_t data_len;
+static size_t pos;
+static size_t evt_num;
+static size_t dispatch_num;
+static ReplayTask *expect;
+static int verbose;
+
+static uint64_t _get(size_t len)
+{
+    uint64_t value = 0;
+
+    for(size_t i = 0; i < len; i++) {
+        value |= (uint64_t)data[pos + i] << (8 * i);
+    }
+    pos += len;
+    return value;
+}
+
+static uint64_t _varint(void)
+{
+    uint64_t value = 0;
+    int shift = 0;
+
+    while(pos < data_len) {
+        uint8_t byte = data[pos++];
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if(!(byte & 0x80)) {
+            break;
+        }
+        shift += 7;
+    }
+    return value;
+}
+
+// Decode the next event, a truncated tail (recording cut short) reads as the end of the stream
+static int _next(ReplayEvt *evt)
+{
+    if(pos >= data_len) {
+        return -1;
+    }
+    memset(evt, 0, sizeof(ReplayEvt));
+    evt->type = data[pos++];
+    switch(evt->type) {
+    case QTASK_REC_TICK:
+    case QTASK_REC_END:
+        break;
+    case QTASK_REC_ADVANCE:
+    case QTASK_REC_SLEEP:
+        evt->arg = _varint();
+        break;
+    case QTASK_REC_POLICY:
+        evt->arg = (pos < data_len) ? data[pos++] : 0;
+        break;
+    default:
+        if(evt->type > QTASK_REC_PHASE) {
+            pos = data_len;
+            return -1;
+        }
+        evt->key = _varint();
+        if(evt->type == QTASK_REC_PRIO) {
+            evt->arg = (pos < data_len) ? data[pos++] : 0;
+        } else if(evt->type == QTASK_REC_DEFER || evt->type == QTASK_REC_PHASE) {
+            evt->arg = _varint();
+        } else if(evt->type == QTASK_REC_ADD) {
+            evt->name_len = (pos < data_len) ? data[pos++] : 0;
+            evt->name = &data[pos];
+            pos += evt->name_len;
+            evt->arg = _varint();
+        } else if(evt->type == QTASK_REC_CONFIG || evt->type == QTASK_REC_CONFIG_TICK) {
+            evt->arg = _varint();
+            evt->deadline = _varint();
+            evt->overrun = (pos < data_len) ? data[pos++] : 0;
+            evt->catchup = _varint();
+        }
+        break;
+    }
+    if(pos > data_len) {
+        pos = data_len;
+        return -1;
+    }
+    evt_num++;
+    return 0;
+}
+
+static int _peek(void)
+{
+    return (pos < data_len) ? data[pos] : -1;
+}
+
+static ReplayTask *_find(uint64_t key)
+{
+    for(size_t i = 0; i < task_num; i++) {
+        if(tasks[i]->key == key) {
+            return tasks[i];
+        }
+    }
+    return QNULL;
+}
+
+static void _diverge(const char *what, ReplayTask *got)
+{
+    fprintf(stderr, "diverged at event %zu, tick %llu: %s, recorded %s, replayed %s\n", evt_num,
+            (unsigned long long)sched.tick, what, expect ? expect->name : "?", got ? got->name : "nothing");
+    exit(2);
+}
+
+static char *_strdup(const uint8_t *name, uint8_t name_len)
+{
+    char *str = malloc((size_t)name_len + 1);
+
+    if(!str) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    memcpy(str, name, name_len);
+    str[name_len] = '\0';
+    return str;
+}
+
+static void _run(int nested);
+
+static void _handle(void *ctx)
+{
+    ReplayTask *task = ctx;
+
+    if(task != expect) {
+        _diverge("handler", task);
+    }
+    _run(1);
+}
+
+static void _config(const ReplayEvt *evt)
+{
+    ReplayTask *task = _find(evt->key);
+
+    if(!task) {
+        return;
+    }
+    qtask_tick_set(&task->obj, (size_t)evt->arg);
+#if QTASK_USING_EDF || QTASK_USING_DEADLINE
+    qtask_deadline_set(&task->obj, (size_t)evt->deadline);
+#endif
+#if QTASK_USING_OVERRUN
+    qtask_overrun_set(&task->obj, evt->overrun, (uint16_t)evt->catchup);
+#endif
+}
+
+// One replay object per recorded object, so that every call acts on the same objects as on the target
+static ReplayTask *_new(const ReplayEvt *evt)
+{
+    ReplayTask *task = _find(evt->key);
+
+    if(!task) {
+        if(task_num == task_cap) {
+            task_cap = task_cap ? task_cap * 2 : 64;
+            tasks = realloc(tasks, task_cap * sizeof(ReplayTask *));
+        }
+        task = calloc(1, sizeof(ReplayTask));
+        if(!tasks || !task) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        task->key = evt->key;
+        task->name = _strdup((const uint8_t *)"", 0);
+        tasks[task_num++] = task;
+    }
+    return task;
+}
+
+static void _add(const ReplayEvt *evt)
+{
+    ReplayTask *task = _new(evt);
+    char *name = task->name;
+
+    // The old name has to stay valid while the add looks the old registration up
+    if(strlen(name) != evt->name_len || memcmp(name, evt->name, evt->name_len) != 0) {
+        name = _strdup(evt->name, evt->name_len);
+    }
+    if(qtask_add_ctx(&sched, &task->obj, name, _handle, task, (size_t)evt->arg) != 0) {
+        fprintf(stderr, "event %zu: cannot add %s, a task of that name is already scheduled\n", evt_num, name);
+        exit(1);
+    }
+    if(name != task->name) {
+        free(task->name);
+        task->name = name;
+    }
+}
+
+static void _apply(ReplayEvt *evt)
+{
+    ReplayTask *task = QNULL;
+    QTaskObj *obj;
+    ReplayEvt cfg;
+    ReplayTask *saved;
+
+    if(evt->type != QTASK_REC_ADD && evt->key) {
+        task = _find(evt->key);
+    }
+    switch(evt->type) {
+    case QTASK_REC_TICK:
+    case QTASK_REC_ADVANCE:
+        // Changes recorded at release were made before the tick, apply them first
+        while(_peek() == QTASK_REC_CONFIG_TICK && _next(&cfg) == 0) {
+            _config(&cfg);
+        }
+        if(evt->type == QTASK_REC_TICK) {
+            qtask_tick_increase(&sched);
+        } else {
+            qtask_tick_advance(&sched, (size_t)evt->arg);
+        }
+        break;
+    case QTASK_REC_DISPATCH:
+        saved = expect;
+        expect = task;
+        if(verbose) {
+            printf("%llu %s\n", (unsigned long long)sched.tick, task ? task->name : "?");
+        }
+        dispatch_num++;
+        obj = qtask_exec_once(&sched);
+        if(!obj || !task || obj != &task->obj) {
+            expect = task;
+            _diverge("dispatch", obj ? (ReplayTask *)obj->ctx : QNULL);
+        }
+        expect = saved;
+        break;
+    case QTASK_REC_END:
+        fprintf(stderr, "event %zu: handler end outside a handler\n", evt_num);
+        exit(1);
+    case QTASK_REC_ADD:
+        _add(evt);
+        break;
+    case QTASK_REC_DEFER:
+        task = _new(evt);
+        qtask_defer(&sched, &task->obj, _handle, task, (size_t)evt->arg);
+        // Same id as on the target, it only shows in traces
+        task->obj.id = (uint32_t)evt->key;
+        break;
+    case QTASK_REC_CANCEL:
+        if(task) {
+            qtask_cancel(&sched, &task->obj);
+        }
+        break;
+    case QTASK_REC_PHASE:
+        if(task) {
+            qtask_phase_set(&sched, &task->obj, (size_t)evt->arg);
+        }
+        break;
+    case QTASK_REC_DEL:
+        if(task) {
+            qtask_del(&sched, &task->obj);
+        }
+        break;
+    case QTASK_REC_SUSPEND:
+        if(task) {
+            qtask_suspend(&sched, task->name);
+        }
+        break;
+    case QTASK_REC_RESUME:
+        if(task) {
+            qtask_resume(&sched, task->name);
+        }
+        break;
+    case QTASK_REC_PRIO:
+        if(task) {
+            qtask_prio_set(&sched, &task->obj, (uint8_t)evt->arg);
+        }
+        break;
+    case QTASK_REC_SLEEP:
+        qtask_sleep(&sched, (size_t)evt->arg);
+        break;
+    case QTASK_REC_POLICY:
+        qtask_policy_set(&sched, (uint8_t)evt->arg);
+        break;
+    default:
+        _config(evt);
+        break;
+    }
+}
+
+// Apply events until the end of the stream, or inside a handler until the handler end
+static void _run(int nested)
+{
+    ReplayEvt evt;
+
+    while(_next(&evt) == 0) {
+        if(evt.type == QTASK_REC_END && nested) {
+            return;
+        }
+        _apply(&evt);
+    }
+}
+
+static int _header(void)
+{
+    uint16_t flags = 0;
+    uint64_t version, rflags, prio, scan, heap;
+
+    if(data_len < HEADER_LEN || memcmp(data, "QREC", 4) != 0) {
+        return -1;
+    }
+    pos = 4;
+    version = _get(2);
+    rflags = _get(2);
+    prio = _get(2);
+    scan = _get(4);
+    heap = _get(4);
+    if(version != QTASK_REC_VERSION) {
+        return -1;
+    }
+#if QTASK_USING_WHEEL
+    flags |= QTASK_REC_FLAG_WHEEL;
+#endif
+#if QTASK_USING_EDF
+    flags |= QTASK_REC_FLAG_EDF;
+#endif
+#if QTASK_USING_ABSOLUTE
+    flags |= QTASK_REC_FLAG_ABSOLUTE;
+#endif
+    if(rflags != flags || prio != QTASK_PRIO_NUM || scan != QTASK_TICK_SCAN_MAX || heap != QTASK_EDF_HEAP_SIZE) {
+        fprintf(stderr, "warning: recorded with flags 0x%x, %u priorities, scan bound %u, EDF heap %u,"
+                " the dispatch order may differ\n", (unsigned)rflags, (unsigned)prio, (unsigned)scan, (unsigned)heap);
+    }
+    return 0;
+}
+
+static void _replay(void)
+{
+    for(size_t i = 0; i < task_num; i++) {
+        free(tasks[i]->name);
+        free(tasks[i]);
+    }
+    task_num = 0;
+    evt_num = 0;
+    dispatch_num = 0;
+    expect = QNULL;
+
+    qtask_sched_init(&sched);
+#if QTASK_USING_IDLE
+    qtask_idle_set(&sched, QNULL);
+#endif
+    pos = HEADER_LEN - 9;
+    sched.tick = _get(8);
+    qtask_policy_set(&sched, data[pos++]);
+    _run(0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = QNULL;
+    size_t repeat = 1;
+    FILE *fp;
+    long len;
+    clock_t wall;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-v") == 0) {
+            verbose = 1;
+        } else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            repeat = strtoul(argv[++i], QNULL, 0);
+        } else if(argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            path = QNULL;
+            break;
+        }
+    }
+    if(!path) {
+        fprintf(stderr, "usage: %s [-v] [-r repeat] <record.bin>\n", argv[0]);
+        return 1;
+    }
+    fp = fopen(path, "rb");
+    if(!fp) {
+        perror(path);
+        return 1;
+    }
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data = malloc(len > 0 ? (size_t)len : 1);
+    if(!data || len < 0 || fread(data, 1, (size_t)len, fp) != (size_t)len) {
+        fprintf(stderr, "%s: read failed\n", path);
+        return 1;
+    }
+    fclose(fp);
+    data_len = (size_t)len;
+    if(_header()) {
+        fprintf(stderr, "%s: not a qtask record\n", path);
+        return 1;
+    }
+
+    wall = clock();
+    for(size_t i = 0; i < repeat; i++) {
+        _replay();
+    }
+    wall = clock() - wall;
+
+    fprintf(stderr, "%zu events, %llu ticks, %zu dispatches replayed identically, %.3f s per replay\n", evt_num,
+            (unsigned long long)sched.tick, dispatch_num, (double)wall / CLOCKS_PER_SEC / (double)(repeat ? repeat : 1));
+    return 0;
+}
@@ -0,0 +1,511 @@
+/*
+ * Virtual time simulator, runs a task set through the real scheduler faster than real time.
+ *
+ * The scheduler clock is replaced by a virtual nanosecond clock. Each handler advances it by an
+ * execution time drawn from the task model, ticks whose boundary falls inside a handler are
+ * delivered at that boundary as the timer interrupt would, idle stretches are skipped with
+ * qtask_tick_next/qtask_tick_advance. Build with the same options as the target plus statistics
+ * and deadline detection:
+ *   cc -O2 -I.. -DQTASK_USING_STATS=1 -DQTASK_USING_DEADLINE=1 -DQTASK_USING_OVERRUN=1 -o qtask_sim qtask_sim.c ../qtask.c -lm
+ *   cc -O2 -I.. -DQTASK_USING_STATS=1 -DQTASK_USING_DEADLINE=1 -DQTASK_USING_OVERRUN=1 -DQTASK_USING_EDF=1 -o qtask_sim qtask_sim.c ../qtask.c -lm
+ * Usage: qtask_sim [-t tick_us] [-n hyperperiods] [-T ticks] [-s seed] [-e] <taskset>
+ *   -t  tick length in microseconds (default 1000)
+ *   -n  number of hyperperiods to run (default 10), the hyperperiod is the lcm of all periods
+ *   -T  number of ticks to run instead, for task sets with a huge hyperperiod
+ *   -s  random seed (default 1)
+ *   -e  dispatch with QTASK_POLICY_EDF
+ *
+ * Task set, one task per line, '#' starts a comment:
+ *   <name> <period_ticks> <exec> [prio=N] [deadline=TICKS] [overrun=once|skip|catchup:N]
+ * Execution time models, times in microseconds:
+ *   const:C  uniform:MIN:MAX  normal:MEAN:SD  exp:MEAN
+ *   file:PATH         one time per line, replayed in order
+ *   trace:PATH[:NAME] handler times of NAME (default the task name) in a qtask_trace_dump file,
+ *                     replayed in order, clock readings are taken as nanoseconds
+ * The deadline defaults to the period, misses are counted as in QTaskObj::dmiss. The response
+ * time is measured from the release of the oldest pending activation to the end of the handler.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "qtask.h"
+
+#if !QTASK_USING_STATS || !QTASK_USING_DEADLINE || !QTASK_USING_OVERRUN
+#error "build the simulator with -DQTASK_USING_STATS=1 -DQTASK_USING_DEADLINE=1 -DQTASK_USING_OVERRUN=1"
+#endif
+
+#define SIM_NAME_LEN    32
+#define SIM_TICKS_MAX   4000000000ull
+
+#define MODEL_CONST     0
+#define MODEL_UNIFORM   1
+#define MODEL_NORMAL    2
+#define MODEL_EXP       3
+#define MODEL_SAMPLES   4
+
+typedef struct {
+    QTaskObj obj;
+    char name[SIM_NAME_LEN];
+    size_t period;
+    uint8_t prio;
+    size_t deadline;
+    uint8_t overrun;
+    uint16_t catchup;
+    int model;
+    double a, b;            /* Model parameters in nanoseconds. */
+    uint32_t *samples;
+    size_t sample_num;
+    size_t sample_cap;
+    size_t sample_idx;
+    uint64_t runs;
+    uint64_t busy;
+    uint64_t resp_sum;
+    uint32_t resp_max;
+} SimTask;
+
+static QTaskSched sched;
+static SimTask *tasks;
+static size_t task_num;
+static uint64_t now;
+static uint64_t tick_ns = 1000000;
+static uint64_t tick_end;
+static uint64_t busy;
+static uint64_t rng = 1;
+
+static uint32_t _clock(void)
+{
+    return (uint32_t)now;
+}
+
+static double _rand(void)
+{
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return (double)((rng * 2685821657736338717ull) >> 11) / 9007199254740992.0;
+}
+
+static uint64_t _exec_time(SimTask *task)
+{
+    double t;
+
+    switch(task->model) {
+    case MODEL_UNIFORM:
+        t = task->a + (task->b - task->a) * _rand();
+        break;
+    case MODEL_NORMAL:
+        t = task->a + task->b * sqrt(-2.0 * log(1.0 - _rand())) * cos(6.283185307179586 * _rand());
+        break;
+    case MODEL_EXP:
+        t = -task->a * log(1.0 - _rand());
+        break;
+    case MODEL_SAMPLES:
+        t = task->samples[task->sample_idx];
+        task->sample_idx = (task->sample_idx + 1) % task->sample_num;
+        break;
+    default:
+        t = task->a;
+        break;
+    }
+    return (t > 0) ? (uint64_t)(t + 0.5) : 0;
+}
+
+static double _exec_mean(const SimTask *task)
+{
+    double sum = 0;
+
+    switch(task->model) {
+    case MODEL_UNIFORM:
+        return (task->a + task->b) / 2;
+    case MODEL_SAMPLES:
+        for(size_t i = 0; i < task->sample_num; i++) {
+            sum += task->samples[i];
+        }
+        return sum / (double)task->sample_num;
+    default:
+        return task->a;
+    }
+}
+
+// Burn virtual time, delivering the ticks whose boundary is crossed at the boundary itself
+static void _handle(void *ctx)
+{
+    SimTask *task = ctx;
+    uint32_t release = task->obj.release;
+    uint64_t cost = _exec_time(task);
+    uint64_t end = now + cost;
+    uint32_t resp;
+
+    while(sched.tick < tick_end && (sched.tick + 1) * tick_ns <= end) {
+        now = (sched.tick + 1) * tick_ns;
+        qtask_tick_increase(&sched);
+    }
+    now = end;
+
+    resp = (uint32_t)now - release;
+    task->runs++;
+    task->busy += cost;
+    task->resp_sum += resp;
+    if(resp > task->resp_max) {
+        task->resp_max = resp;
+    }
+    busy += cost;
+}
+
+static int _samples_add(SimTask *task, double value)
+{
+    uint32_t *samples;
+
+    if(task->sample_num == task->sample_cap) {
+        task->sample_cap = task->sample_cap ? task->sample_cap * 2 : 16;
+        samples = realloc(task->samples, task->sample_cap * sizeof(uint32_t));
+        if(!samples) {
+            return -1;
+        }
+        task->samples = samples;
+    }
+    task->samples[task->sample_num++] = (value > 0) ? (uint32_t)value : 0;
+    return 0;
+}
+
+static int _samples_file(SimTask *task, const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    double value;
+
+    if(!fp) {
+        perror(path);
+        return -1;
+    }
+    while(fscanf(fp, "%lf", &value) == 1) {
+        if(_samples_add(task, value * 1000)) {
+            break;
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+static int _get(FILE *fp, uint32_t *value, size_t len)
+{
+    uint8_t buf[4];
+
+    if(fread(buf, 1, len, fp) != len) {
+        return -1;
+    }
+    *value = 0;
+    for(size_t i = 0; i < len; i++) {
+        *value |= (uint32_t)buf[i] << (8 * i);
+    }
+    return 0;
+}
+
+// Pair the START and END events of one task in a trace dump
+static int _samples_trace(SimTask *task, const char *path, const char *name)
+{
+    FILE *fp = fopen(path, "rb");
+    char magic[4], buf[256];
+    uint32_t version, flags, names, count, key, len, time, type, start = 0;
+    uint32_t want = 0;
+    int found = 0, running = 0;
+
+    if(!fp) {
+        perror(path);
+        return -1;
+    }
+    if(fread(magic, 1, 4, fp) != 4 || memcmp(magic, "QTRC", 4) != 0 || _get(fp, &version, 2) || _get(fp, &flags, 2)
+       || _get(fp, &names, 4) || _get(fp, &count, 4) || version != QTASK_TRACE_VERSION) {
+        fprintf(stderr, "%s: not a qtask trace dump\n", path);
+        fclose(fp);
+        return -1;
+    }
+    for(uint32_t i = 0; i < names; i++) {
+        if(_get(fp, &key, 4) || _get(fp, &len, 1) || fread(buf, 1, len, fp) != len) {
+            fprintf(stderr, "%s: truncated name table\n", path);
+            fclose(fp);
+            return -1;
+        }
+        buf[len] = '\0';
+        if(strcmp(buf, name) == 0) {
+            want = key;
+            found = 1;
+        }
+    }
+    if(!found) {
+        fprintf(stderr, "%s: no task named %s\n", path, name);
+        fclose(fp);
+        return -1;
+    }
+    for(uint32_t i = 0; i < count; i++) {
+        if(_get(fp, &time, 4) || _get(fp, &key, 4) || _get(fp, &type, 1)) {
+            break;
+        }
+        if(key != want) {
+            continue;
+        }
+        if(type == QTASK_TRACE_START) {
+            start = time;
+            running = 1;
+        } else if(type == QTASK_TRACE_END && running) {
+            if(_samples_add(task, (flags & QTASK_TRACE_FLAG_CLOCK) ? (double)(time - start)
+                                                                    : (double)(time - start) * (double)tick_ns)) {
+                break;
+            }
+            running = 0;
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+static int _parse_model(SimTask *task, char *spec)
+{
+    char *save;
+    char *kind = strtok_r(spec, ":", &save);
+    char *p1 = strtok_r(QNULL, ":", &save);
+    char *p2 = strtok_r(QNULL, ":", &save);
+
+    if(!kind || !p1) {
+        return -1;
+    }
+    if(strcmp(kind, "file") == 0 || strcmp(kind, "trace") == 0) {
+        task->model = MODEL_SAMPLES;
+        if((kind[0] == 'f') ? _samples_file(task, p1) : _samples_trace(task, p1, p2 ? p2 : task->name)) {
+            return -1;
+        }
+        if(task->sample_num == 0) {
+            fprintf(stderr, "%s: no execution time samples for %s\n", p1, task->name);
+            return -1;
+        }
+        return 0;
+    }
+    task->a = atof(p1) * 1000;
+    task->b = p2 ? atof(p2) * 1000 : 0;
+    if(strcmp(kind, "const") == 0) {
+        task->model = MODEL_CONST;
+    } else if(strcmp(kind, "uniform") == 0 && p2) {
+        task->model = MODEL_UNIFORM;
+    } else if(strcmp(kind, "normal") == 0 && p2) {
+        task->model = MODEL_NORMAL;
+    } else if(strcmp(kind, "exp") == 0) {
+        task->model = MODEL_EXP;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int _parse_option(SimTask *task, const char *opt)
+{
+    if(strncmp(opt, "prio=", 5) == 0) {
+        task->prio = (uint8_t)atoi(opt + 5);
+        return (task->prio < QTASK_PRIO_NUM) ? 0 : -1;
+    }
+    if(strncmp(opt, "deadline=", 9) == 0) {
+        task->deadline = strtoul(opt + 9, QNULL, 0);
+        return 0;
+    }
+    if(strcmp(opt, "overrun=once") == 0) {
+        task->overrun = QTASK_OVERRUN_ONCE;
+        return 0;
+    }
+    if(strcmp(opt, "overrun=skip") == 0) {
+        task->overrun = QTASK_OVERRUN_SKIP;
+        return 0;
+    }
+    if(strncmp(opt, "overrun=catchup:", 16) == 0) {
+        task->overrun = QTASK_OVERRUN_CATCHUP;
+        task->catchup = (uint16_t)atoi(opt + 16);
+        return 0;
+    }
+    return -1;
+}
+
+static int _load(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    char line[1024], *tok, *save;
+    size_t lineno = 0, cap = 0;
+    SimTask *task;
+
+    if(!fp) {
+        perror(path);
+        return -1;
+    }
+    while(fgets(line, sizeof(line), fp)) {
+        lineno++;
+        if((tok = strchr(line, '#')) != QNULL) {
+            *tok = '\0';
+        }
+        if((tok = strtok_r(line, " \t\r\n", &save)) == QNULL) {
+            continue;
+        }
+        if(task_num == cap) {
+            cap = cap ? cap * 2 : 16;
+            tasks = realloc(tasks, cap * sizeof(SimTask));
+            if(!tasks) {
+                fprintf(stderr, "out of memory\n");
+                return -1;
+            }
+        }
+        task = &tasks[task_num];
+        memset(task, 0, sizeof(SimTask));
+        snprintf(task->name, SIM_NAME_LEN, "%s", tok);
+        tok = strtok_r(QNULL, " \t\r\n", &save);
+        task->period = tok ? strtoul(tok, QNULL, 0) : 0;
+        tok = strtok_r(QNULL, " \t\r\n", &save);
+        if(task->period == 0 || !tok || _parse_model(task, tok)) {
+            fprintf(stderr, "%s:%zu: expected <name> <period_ticks> <exec>\n", path, lineno);
+            return -1;
+        }
+        while((tok = strtok_r(QNULL, " \t\r\n", &save)) != QNULL) {
+            if(_parse_option(task, tok)) {
+                fprintf(stderr, "%s:%zu: bad option %s\n", path, lineno, tok);
+                return -1;
+            }
+        }
+        task_num++;
+    }
+    fclose(fp);
+    return 0;
+}
+
+static uint64_t _gcd(uint64_t a, uint64_t b)
+{
+    while(b) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static uint64_t _hyperperiod(void)
+{
+    uint64_t h = 1;
+
+    for(size_t i = 0; i < task_num; i++) {
+        h = h / _gcd(h, tasks[i].period) * tasks[i].period;
+        if(h > SIM_TICKS_MAX) {
+            return 0;
+        }
+    }
+    return h;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = QNULL;
+    uint64_t hyper, ticks = 0, hypers = 10;
+    size_t next;
+    double util = 0;
+    int edf = 0;
+    clock_t wall;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            tick_ns = (uint64_t)(atof(argv[++i]) * 1000);
+        } else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            hypers = strtoull(argv[++i], QNULL, 0);
+        } else if(strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            ticks = strtoull(argv[++i], QNULL, 0);
+        } else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            rng = strtoull(argv[++i], QNULL, 0) | 1;
+        } else if(strcmp(argv[i], "-e") == 0) {
+            edf = 1;
+        } else if(argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            path = QNULL;
+            break;
+        }
+    }
+    if(!path || tick_ns == 0) {
+        fprintf(stderr, "usage: %s [-t tick_us] [-n hyperperiods] [-T ticks] [-s seed] [-e] <taskset>\n", argv[0]);
+        return 1;
+    }
+    if(_load(path) || task_num == 0) {
+        return 1;
+    }
+    hyper = _hyperperiod();
+    if(ticks == 0) {
+        if(hyper == 0 || hyper * hypers > SIM_TICKS_MAX) {
+            fprintf(stderr, "hyperperiod too long, give the run length with -T\n");
+            return 1;
+        }
+        ticks = hyper * hypers;
+    }
+    tick_end = ticks;
+
+    qtask_sched_init(&sched);
+#if QTASK_USING_IDLE
+    qtask_idle_set(&sched, QNULL);
+#endif
+    qtask_clock_set(&sched, _clock);
+    if(edf && qtask_policy_set(&sched, QTASK_POLICY_EDF)) {
+        fprintf(stderr, "EDF is not available, build with -DQTASK_USING_EDF=1\n");
+        return 1;
+    }
+    for(size_t i = 0; i < task_num; i++) {
+        SimTask *task = &tasks[i];
+        if(qtask_add_ctx(&sched, &task->obj, task->name, _handle, task, task->period) != 0) {
+            fprintf(stderr, "%s: cannot add task, duplicate name\n", task->name);
+            return 1;
+        }
+        qtask_prio_set(&sched, &task->obj, task->prio);
+        qtask_deadline_set(&task->obj, task->deadline ? task->deadline : task->period);
+        if(task->overrun != QTASK_OVERRUN_ONCE && qtask_overrun_set(&task->obj, task->overrun, task->catchup)) {
+            fprintf(stderr, "%s: bad overrun policy\n", task->name);
+            return 1;
+        }
+        util += _exec_mean(task) / ((double)task->period * (double)tick_ns);
+    }
+
+    wall = clock();
+    while(sched.tick < ticks) {
+        qtask_exec(&sched);
+        if(sched.tick >= ticks) {
+            break;
+        }
+        next = qtask_tick_next(&sched);
+        if(next == QTASK_TICK_NONE || next > ticks - sched.tick) {
+            next = (size_t)(ticks - sched.tick);
+        }
+        next = next ? next : 1;
+        // Releases read the clock, it has to be on the tick boundary before they are delivered
+        if(now < (sched.tick + next) * tick_ns) {
+            now = (sched.tick + next) * tick_ns;
+        }
+        qtask_tick_advance(&sched, next);
+    }
+    // Run the releases of the last tick too, every release in the run is reported
+    qtask_exec(&sched);
+    wall = clock() - wall;
+
+    if(hyper) {
+        printf("ticks %llu, %.2f hyperperiods of %llu ticks\n", (unsigned long long)sched.tick,
+               (double)sched.tick / (double)hyper, (unsigned long long)hyper);
+    } else {
+        printf("ticks %llu\n", (unsigned long long)sched.tick);
+    }
+    printf("virtual time %.3f s, simulated in %.3f s\n", (double)now / 1e9, (double)wall / CLOCKS_PER_SEC);
+    printf("utilization %.2f%%, task set estimate %.2f%%\n", now ? 100.0 * (double)busy / (double)now : 0.0,
+           100.0 * util);
+    printf("%-16s %8s %4s %10s %8s %8s %10s %10s %10s\n", "task", "period", "prio", "runs", "missed", "dmiss",
+           "exec_us", "resp_us", "resp_max");
+    for(size_t i = 0; i < task_num; i++) {
+        SimTask *task = &tasks[i];
+        printf("%-16s %8zu %4u %10llu %8u %8u %10.1f %10.1f %10.1f\n", task->name, task->period, task->prio,
+               (unsigned long long)task->runs, task->obj.missed, task->obj.dmiss,
+               task->runs ? (double)task->busy / (double)task->runs / 1000 : 0.0,
+               task->runs ? (double)task->resp_sum / (double)task->runs / 1000 : 0.0, (double)task->resp_max / 1000);
+        free(task->samples);
+    }
+    free(tasks);
+    return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * Converts a trace dumped by qtask_trace_dump into Chrome trace-event JSON, open the result
+ * in https://ui.perfetto.dev or chrome://tracing.
+ *
+ * Build: cc -O2 -I.. -o qtrace2json qtrace2json.c
+ * Usage: qtrace2json <dump.bin> [units_per_second] > trace.json
+ *
+ * units_per_second is the rate of the recorded time base, it defaults to 1000000000 for clock
+ * readings (the Linux default clock counts nanoseconds) and to 1000 for tick counts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "qtask.h"
+
+#define LANE_CPU    0
+#define LANE_TICK   1
+#define LANE_TASK   2
+
+typedef struct {
+    uint32_t key;
+    char name[256];
+} TraceName;
+
+typedef struct {
+    uint32_t key;
+    int lane;
+} TraceLane;
+
+static TraceName *names;
+static uint32_t name_num;
+static TraceLane *lanes;
+static int lane_num;
+
+static int _get(FILE *fp, uint32_t *value, size_t len)
+{
+    uint8_t buf[4];
+
+    if(fread(buf, 1, len, fp) != len) {
+        return -1;
+    }
+    *value = 0;
+    for(size_t i = 0; i < len; i++) {
+        *value |= (uint32_t)buf[i] << (8 * i);
+    }
+    return 0;
+}
+
+static void _put_str(const char *str)
+{
+    putchar('"');
+    for(; *str; str++) {
+        if(*str == '"' || *str == '\\') {
+            printf("\\%c", *str);
+        } else if((unsigned char)*str < 0x20) {
+            printf("\\u%04x", (unsigned char)*str);
+        } else {
+            putchar(*str);
+        }
+    }
+    putchar('"');
+}
+
+// Tasks deleted before the dump and one-shot calls have no name, their key stands in
+static const char *_name(uint32_t key)
+{
+    static char buf[16];
+
+    for(uint32_t i = 0; i < name_num; i++) {
+        if(names[i].key == key && names[i].name[0]) {
+            return names[i].name;
+        }
+    }
+    snprintf(buf, sizeof(buf), "#%u", key);
+    return buf;
+}
+
+// Every task gets its own lane for releases and state changes, created on first sight
+static int _lane(uint32_t key, int *first)
+{
+    for(int i = 0; i < lane_num; i++) {
+        if(lanes[i].key == key) {
+            *first = 0;
+            return lanes[i].lane;
+        }
+    }
+    lanes[lane_num].key = key;
+    lanes[lane_num].lane = LANE_TASK + lane_num;
+    *first = 1;
+    return lanes[lane_num++].lane;
+}
+
+static void _meta(int lane, const char *name, int *sep)
+{
+    printf("%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", *sep ? "," : "", lane);
+    _put_str(name);
+    printf("}}");
+    *sep = 1;
+}
+
+static void _event(const char *name, const char *ph, int lane, double ts, int *sep)
+{
+    printf("%s\n{\"name\":", *sep ? "," : "");
+    _put_str(name);
+    printf(",\"ph\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f", ph, lane, ts);
+    if(ph[0] == 'i') {
+        printf(",\"s\":\"t\"");
+    }
+    printf("}");
+    *sep = 1;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *const kind[] = { "tick", "release", "start", "end", "suspend", "resume", "add", "del" };
+    FILE *fp;
+    char magic[4];
+    uint32_t version, flags, count, len, time, key, type;
+    uint32_t prev = 0;
+    int64_t stamp = 0;
+    double scale;
+    int depth = 0, sep = 0, first, lane;
+
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s <dump.bin> [units_per_second]\n", argv[0]);
+        return 1;
+    }
+    fp = fopen(argv[1], "rb");
+    if(!fp) {
+        perror(argv[1]);
+        return 1;
+    }
+    if(fread(magic, 1, 4, fp) != 4 || memcmp(magic, "QTRC", 4) != 0 || _get(fp, &version, 2) || _get(fp, &flags, 2)
+       || _get(fp, &name_num, 4) || _get(fp, &count, 4)) {
+        fprintf(stderr, "%s: not a qtask trace dump\n", argv[1]);
+        return 1;
+    }
+    if(version != QTASK_TRACE_VERSION) {
+        fprintf(stderr, "%s: unsupported trace version %u\n", argv[1], version);
+        return 1;
+    }
+    scale = (argc > 2) ? atof(argv[2]) : ((flags & QTASK_TRACE_FLAG_CLOCK) ? 1e9 : 1e3);
+    scale = 1e6 / scale;
+
+    names = calloc(name_num ? name_num : 1, sizeof(TraceName));
+    lanes = calloc(count + 1, sizeof(TraceLane));
+    if(!names || !lanes) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for(uint32_t i = 0; i < name_num; i++) {
+        if(_get(fp, &names[i].key, 4) || _get(fp, &len, 1) || fread(names[i].name, 1, len, fp) != len) {
+            fprintf(stderr, "%s: truncated name table\n", argv[1]);
+            return 1;
+        }
+    }
+
+    printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    _meta(LANE_CPU, "cpu", &sep);
+    _meta(LANE_TICK, "tick", &sep);
+    for(uint32_t i = 0; i < count; i++) {
+        if(_get(fp, &time, 4) || _get(fp, &key, 4) || _get(fp, &type, 1)) {
+            fprintf(stderr, "%s: truncated after %u events\n", argv[1], i);
+            break;
+        }
+        // Times are 32-bit readings, unwrap them by the signed step so that events logged slightly out
+        // of order (a tick taken inside a handler) step back instead of jumping a whole wrap ahead
+        stamp = (i > 0) ? stamp + (int32_t)(time - prev) : (int64_t)time;
+        prev = time;
+        double ts = (double)stamp * scale;
+
+        switch(type) {
+        case QTASK_TRACE_TICK:
+            _event("tick", "i", LANE_TICK, ts, &sep);
+            break;
+        case QTASK_TRACE_START:
+            _event(_name(key), "B", LANE_CPU, ts, &sep);
+            depth++;
+            break;
+        case QTASK_TRACE_END:
+            // The ring may begin in the middle of a run
+            if(depth > 0) {
+                _event(_name(key), "E", LANE_CPU, ts, &sep);
+                depth--;
+            }
+            break;
+        default:
+            if(type >= sizeof(kind) / sizeof(kind[0])) {
+                break;
+            }
+            lane = _lane(key, &first);
+            if(first) {
+                _meta(lane, _name(key), &sep);
+            }
+            _event(kind[type], "i", lane, ts, &sep);
+            break;
+        }
+    }
+    printf("\n]}\n");
+    fclose(fp);
+    return 0;
+}